@@ -0,0 +1,425 @@
+/*
+  ==============================================================================
+
+    ConvolutionReverb.cpp
+
+  ==============================================================================
+*/
+
+#include "ConvolutionReverb.h"
+
+namespace
+{
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= juce::square(x * 0.5 / k);
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // Windowed-sinc resampling of a whole IR. The cutoff sits below the lower
+    // of the two Nyquist frequencies, so when decimating nothing above the
+    // session's Nyquist folds back into it, and when interpolating no images
+    // are left above the IR's
+    void resampleImpulseResponse(const juce::AudioBuffer<float>& source, juce::AudioBuffer<float>& destination,
+                                 double ratio)
+    {
+        constexpr double zeroCrossings = 32.0;  // Each side, in periods of the lower rate
+        constexpr double kaiserBeta = 8.0;      // About 80 dB of stopband
+        constexpr int tableSteps = 256;         // Kernel resolution per input sample
+
+        const auto lowerRate = juce::jmin(1.0, 1.0 / ratio);
+        const auto cutoff = 0.9 * lowerRate;
+        const auto halfWidth = zeroCrossings / lowerRate;
+
+        // One side of the symmetric kernel, tabulated so the inner loop is a lookup
+        std::vector<float> kernel((size_t) std::ceil(halfWidth * tableSteps) + 2, 0.0f);
+        const auto windowScale = 1.0 / besselI0(kaiserBeta);
+
+        for (size_t i = 0; i < kernel.size(); ++i)
+        {
+            const auto t = (double) i / tableSteps;
+            const auto w = t / halfWidth;
+
+            if (w >= 1.0)
+                break;
+
+            const auto x = juce::MathConstants<double>::pi * cutoff * t;
+            const auto sinc = i == 0 ? 1.0 : std::sin(x) / x;
+            kernel[i] = (float) (cutoff * sinc * besselI0(kaiserBeta * std::sqrt(1.0 - w * w)) * windowScale);
+        }
+
+        const auto numInput = source.getNumSamples();
+
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        {
+            const auto* input = source.getReadPointer(channel);
+            auto* output = destination.getWritePointer(channel);
+
+            for (int n = 0; n < destination.getNumSamples(); ++n)
+            {
+                const auto centre = n * ratio;
+                const auto first = juce::jmax(0, (int) std::ceil(centre - halfWidth));
+                const auto last = juce::jmin(numInput - 1, (int) std::floor(centre + halfWidth));
+                double sum = 0.0;
+
+                for (int k = first; k <= last; ++k)
+                {
+                    const auto position = std::abs(k - centre) * tableSteps;
+                    const auto index = (size_t) position;
+                    const auto frac = (float) (position - (double) index);
+                    sum += input[k] * (kernel[index] + frac * (kernel[index + 1] - kernel[index]));
+                }
+
+                output[n] = (float) sum;
+            }
+        }
+    }
+}
+
+ConvolutionReverb::ConvolutionReverb()
+    : juce::Thread("IKReverb IR loader")
+{
+    formatManager.registerBasicFormats();
+    startThread(juce::Thread::Priority::low);
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    stopThread(4000);
+
+    destroyEngine(activeEngine);
+    destroyEngine(pendingEngine.exchange(nullptr));
+    destroyEngine(retiredEngine.exchange(nullptr));
+}
+
+void ConvolutionReverb::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    juce::AudioBuffer<float> source;
+    double sourceRate = 0.0;
+
+    {
+        const juce::ScopedLock sl(requestLock);
+
+        // Same rate and layout: the engine we have still fits
+        if (spec.sampleRate == sampleRate && (int) spec.numChannels == numChannels)
+        {
+            reset();
+            return;
+        }
+
+        sampleRate = spec.sampleRate;
+        numChannels = (int) spec.numChannels;
+        rebuildRequested = false;
+        ++generation;
+
+        source.makeCopyOf(sourceIR);
+        sourceRate = sourceSampleRate;
+    }
+
+    // The audio thread is stopped, so the old engines can go right away
+    destroyEngine(std::exchange(activeEngine, nullptr));
+    destroyEngine(pendingEngine.exchange(nullptr));
+    destroyEngine(retiredEngine.exchange(nullptr));
+
+    // Blocking is allowed here, and the first block after a prepare (an
+    // offline bounce's included) must already be convolved
+    if (source.getNumSamples() > 0)
+        if (auto engine = buildEngine(source, sourceRate, spec.sampleRate, (int) spec.numChannels))
+            activeEngine = registerEngine(std::move(engine)).release();
+}
+
+void ConvolutionReverb::reset() noexcept
+{
+    if (activeEngine != nullptr)
+        for (auto& convolver : activeEngine->channels)
+            convolver->reset();
+}
+
+void ConvolutionReverb::loadImpulseResponse(const juce::File& file)
+{
+    {
+        const juce::ScopedLock sl(requestLock);
+        requestedFile = file;
+        fileRequested = true;
+    }
+
+    notify();
+}
+
+void ConvolutionReverb::loadImpulseResponse(const juce::AudioBuffer<float>& impulseResponse, double irSampleRate,
+                                            const juce::String& name)
+{
+    {
+        const juce::ScopedLock sl(requestLock);
+        sourceIR.makeCopyOf(impulseResponse);
+        sourceSampleRate = irSampleRate;
+        irName = name;
+        fileRequested = false;
+        rebuildRequested = true;
+    }
+
+    notify();
+    sendChangeMessage();
+}
+
+juce::String ConvolutionReverb::getImpulseResponseName() const
+{
+    const juce::ScopedLock sl(requestLock);
+    return irName;
+}
+
+bool ConvolutionReverb::hasImpulseResponse() const
+{
+    const juce::ScopedLock sl(requestLock);
+    return sourceIR.getNumSamples() > 0;
+}
+
+bool ConvolutionReverb::isBuilding() const
+{
+    const juce::ScopedLock sl(requestLock);
+    return fileRequested || rebuildRequested || building;
+}
+
+//==============================================================================
+void ConvolutionReverb::process(const juce::dsp::ProcessContextReplacing<float>& context) noexcept
+{
+    auto& block = context.getOutputBlock();
+
+    if (! beginBlock())
+    {
+        block.clear();
+        return;
+    }
+
+    for (size_t channel = 0; channel < block.getNumChannels(); ++channel)
+        processChannel(block, channel);
+}
+
+bool ConvolutionReverb::beginBlock() noexcept
+{
+    // Take over a freshly built engine once the previous one has been collected
+    if (pendingEngine.load(std::memory_order_acquire) != nullptr
+         && retiredEngine.load(std::memory_order_acquire) == nullptr)
+    {
+        if (auto* next = pendingEngine.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            retiredEngine.store(activeEngine, std::memory_order_release);
+            activeEngine = next;
+        }
+    }
+
+    if (activeEngine == nullptr)
+        return false;
+
+    // Read once, so every channel's tail runs the same way for this block
+    const auto inlineTail = nonRealtime.load(std::memory_order_relaxed);
+
+    for (auto& convolver : activeEngine->channels)
+        convolver->setTailInline(inlineTail);
+
+    // Other threads can't look at the engine itself, the loader may be freeing it
+    int underruns = 0;
+
+    for (auto& convolver : activeEngine->channels)
+        underruns += convolver->getNumTailUnderruns();
+
+    tailUnderruns.store(underruns, std::memory_order_relaxed);
+
+    return ! activeEngine->channels.empty();
+}
+
+void ConvolutionReverb::processChannel(const juce::dsp::AudioBlock<float>& block, size_t channel) noexcept
+{
+    // Each channel has its own convolver, so channels can run in parallel
+    const auto numEngineChannels = activeEngine->channels.size();
+    activeEngine->channels[channel % numEngineChannels]->process(block.getChannelPointer(channel),
+                                                                 (int) block.getNumSamples());
+}
+
+//==============================================================================
+void ConvolutionReverb::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(500);
+        collectGarbage();
+
+        juce::File file;
+        bool loadFile = false;
+
+        {
+            const juce::ScopedLock sl(requestLock);
+            std::swap(loadFile, fileRequested);
+            file = requestedFile;
+            building = loadFile;
+        }
+
+        if (loadFile)
+            readFile(file);
+
+        juce::AudioBuffer<float> source;
+        double sourceRate = 0.0, targetRate = 0.0;
+        int channels = 0, requestGeneration = 0;
+        bool rebuild = false;
+
+        {
+            const juce::ScopedLock sl(requestLock);
+            std::swap(rebuild, rebuildRequested);
+
+            if (rebuild)
+            {
+                source.makeCopyOf(sourceIR);
+                sourceRate = sourceSampleRate;
+                targetRate = sampleRate;
+                channels = numChannels;
+                requestGeneration = generation;
+                building = true;
+            }
+        }
+
+        if (rebuild && targetRate > 0.0 && source.getNumSamples() > 0 && channels > 0)
+            publish(buildEngine(source, sourceRate, targetRate, channels), requestGeneration);
+
+        {
+            const juce::ScopedLock sl(requestLock);
+            building = false;
+        }
+    }
+}
+
+bool ConvolutionReverb::readFile(const juce::File& file)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+    if (reader == nullptr || reader->sampleRate <= 0.0)
+        return false;
+
+    const auto length = (int) juce::jmin((juce::int64) (maxImpulseSeconds * reader->sampleRate), reader->lengthInSamples);
+    juce::AudioBuffer<float> buffer((int) juce::jmin(2u, reader->numChannels), length);
+    reader->read(&buffer, 0, length, 0, true, true);
+
+    {
+        const juce::ScopedLock sl(requestLock);
+        sourceIR = std::move(buffer);
+        sourceSampleRate = reader->sampleRate;
+        irName = file.getFileNameWithoutExtension();
+        rebuildRequested = true;
+    }
+
+    sendChangeMessage();
+    return true;
+}
+
+std::unique_ptr<ConvolutionReverb::Engine> ConvolutionReverb::buildEngine(const juce::AudioBuffer<float>& source,
+                                                                          double sourceRate, double targetRate,
+                                                                          int channels)
+{
+    // Resample to the session rate
+    const auto ratio = sourceRate / targetRate;
+    const auto resampledLength = juce::jmax(1, (int) std::ceil(source.getNumSamples() / ratio));
+    juce::AudioBuffer<float> ir(source.getNumChannels(), resampledLength);
+
+    if (std::abs(ratio - 1.0) < 1.0e-9)
+    {
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+            ir.copyFrom(channel, 0, source, channel, 0, juce::jmin(resampledLength, source.getNumSamples()));
+    }
+    else
+    {
+        resampleImpulseResponse(source, ir, ratio);
+    }
+
+    // Drop the inaudible end so it doesn't cost partitions
+    const auto threshold = ir.getMagnitude(0, ir.getNumSamples()) * juce::Decibels::decibelsToGain(-90.0f);
+    auto length = ir.getNumSamples();
+
+    while (length > 1)
+    {
+        bool audible = false;
+
+        for (int channel = 0; channel < ir.getNumChannels(); ++channel)
+            audible = audible || std::abs(ir.getSample(channel, length - 1)) > threshold;
+
+        if (audible)
+            break;
+
+        --length;
+    }
+
+    // Normalise the loudest channel to unit energy
+    double maxEnergy = 0.0;
+
+    for (int channel = 0; channel < ir.getNumChannels(); ++channel)
+    {
+        double energy = 0.0;
+        for (int i = 0; i < length; ++i)
+            energy += juce::square((double) ir.getSample(channel, i));
+
+        maxEnergy = juce::jmax(maxEnergy, energy);
+    }
+
+    if (maxEnergy > 0.0)
+        ir.applyGain(0, length, (float) (1.0 / std::sqrt(maxEnergy)));
+
+    impulseSeconds.store(length / targetRate, std::memory_order_relaxed);
+
+    auto engine = std::make_unique<Engine>();
+
+    // Nothing is registered with the tail worker yet, so a cancelled build
+    // can simply be dropped
+    for (int channel = 0; channel < channels; ++channel)
+    {
+        if (threadShouldExit())
+            return {};
+
+        engine->channels.push_back(std::make_unique<PartitionedConvolver>(ir.getReadPointer(channel % ir.getNumChannels()), length));
+    }
+
+    return engine;
+}
+
+std::unique_ptr<ConvolutionReverb::Engine> ConvolutionReverb::registerEngine(std::unique_ptr<Engine> engine)
+{
+    // Only a finished engine goes to the tail worker; destroyEngine() takes
+    // it off again. Offline, the worker skips it
+    for (auto& convolver : engine->channels)
+        tailWorker->add(convolver.get());
+
+    return engine;
+}
+
+void ConvolutionReverb::publish(std::unique_ptr<Engine> engine, int engineGeneration)
+{
+    // Under the lock, so prepare() can't change the rate between the check
+    // and the handoff; a build for a rate it has replaced is dropped
+    const juce::ScopedLock sl(requestLock);
+
+    if (engine == nullptr || engineGeneration != generation)
+        return;
+
+    // Replace anything the audio thread hasn't picked up yet
+    destroyEngine(pendingEngine.exchange(registerEngine(std::move(engine)).release(), std::memory_order_acq_rel));
+}
+
+void ConvolutionReverb::destroyEngine(Engine* engine)
+{
+    if (engine == nullptr)
+        return;
+
+    for (auto& convolver : engine->channels)
+        tailWorker->remove(convolver.get());
+
+    delete engine;
+}
+
+void ConvolutionReverb::collectGarbage()
+{
+    destroyEngine(retiredEngine.exchange(nullptr, std::memory_order_acq_rel));
+}
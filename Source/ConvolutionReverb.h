@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    ConvolutionReverb.h
+
+    Impulse-response reverb for the CONVOLUTION type. Owns one
+    PartitionedConvolver per channel and a loader thread that reads,
+    resamples, trims and normalises IR files, then hands the finished engine
+    to the audio thread through an atomic pointer. Engines the audio thread
+    has swapped out are freed by the loader thread, never in processBlock.
+    A change message goes out whenever the IR name changes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PartitionedConvolver.h"
+
+class ConvolutionReverb : public juce::ChangeBroadcaster,
+                          private juce::Thread
+{
+public:
+    ConvolutionReverb();
+    ~ConvolutionReverb() override;
+
+    /** Must not run concurrently with process(). Keeps the current engine
+        if the sample rate and channel count are unchanged; otherwise
+        re-partitions the IR for them before returning.
+    */
+    void prepare(const juce::dsp::ProcessSpec& spec);
+
+    /** Audio thread: clears the convolution history. */
+    void reset() noexcept;
+
+    /** Any non-audio thread: loads the file in the background. */
+    void loadImpulseResponse(const juce::File& file);
+
+    /** Any non-audio thread: uses an in-memory IR, resampled in the background. */
+    void loadImpulseResponse(const juce::AudioBuffer<float>& impulseResponse, double irSampleRate,
+                             const juce::String& name);
+
+    void process(const juce::dsp::ProcessContextReplacing<float>& context) noexcept;
+
+    /** Audio thread: process() split in two, so channels can be shared out
+        between threads. beginBlock() takes over a newly loaded engine and
+        returns false if there is nothing to convolve with (the caller then
+        clears the block). processChannel() may then run once per channel,
+        concurrently.
+    */
+    bool beginBlock() noexcept;
+    void processChannel(const juce::dsp::AudioBlock<float>& block, size_t channel) noexcept;
+
+    juce::String getImpulseResponseName() const;
+    bool hasImpulseResponse() const;
+
+    /** True while a requested IR is still being read or built. Once it
+        turns false, the next process() picks up the new engine.
+    */
+    bool isBuilding() const;
+
+    /** Offline rendering: from the next block on, the tail stages run on
+        the audio thread, so none of the tail is ever late. The engine and
+        its history are kept.
+    */
+    void setNonRealtime(bool isNonRealtime) noexcept { nonRealtime.store(isNonRealtime, std::memory_order_relaxed); }
+
+    /** Length of the trimmed IR at the session rate, once it is built. */
+    double getImpulseResponseSeconds() const noexcept { return impulseSeconds.load(std::memory_order_relaxed); }
+    /** Late tail chunks of the engine in use, as of its last block. */
+    int getNumTailUnderruns() const noexcept { return tailUnderruns.load(std::memory_order_relaxed); }
+
+private:
+    struct Engine
+    {
+        std::vector<std::unique_ptr<PartitionedConvolver>> channels;
+    };
+
+    void run() override;
+    bool readFile(const juce::File& file);
+    std::unique_ptr<Engine> buildEngine(const juce::AudioBuffer<float>& source, double sourceRate,
+                                        double targetRate, int numChannels);
+    std::unique_ptr<Engine> registerEngine(std::unique_ptr<Engine> engine);
+    void publish(std::unique_ptr<Engine> engine, int engineGeneration);
+    void destroyEngine(Engine* engine);
+    void collectGarbage();
+
+    juce::SharedResourcePointer<ConvolutionTailWorker> tailWorker;
+    juce::AudioFormatManager formatManager;
+
+    // Shared between the message thread and the loader, never the audio thread
+    juce::CriticalSection requestLock;
+    juce::File requestedFile;
+    juce::AudioBuffer<float> sourceIR;
+    double sourceSampleRate = 0.0;
+    juce::String irName;
+    double sampleRate = 0.0;
+    int numChannels = 2;
+    int generation = 0;         // Bumped by prepare(); builds from an older one are stale
+    bool fileRequested = false;
+    bool rebuildRequested = false;
+    bool building = false;
+
+    // Engine handoff
+    Engine* activeEngine = nullptr;                         // Audio thread only
+    std::atomic<Engine*> pendingEngine { nullptr };         // Loader -> audio
+    std::atomic<Engine*> retiredEngine { nullptr };         // Audio -> loader
+    std::atomic<double> impulseSeconds { 0.0 };
+    std::atomic<int> tailUnderruns { 0 };                   // Audio -> any
+    std::atomic<bool> nonRealtime { false };                // Any -> audio
+
+    static constexpr double maxImpulseSeconds = 20.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionReverb)
+};
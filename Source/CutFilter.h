@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+    CutFilter.h
+
+    Low cut + high cut stage for the wet path, built from two 12 dB/oct
+    topology-preserving-transform state variable filters (Zavalishin/Simper).
+
+    The TPT structure stays stable while its cutoff moves, so both cutoffs are
+    smoothed and the coefficients are refreshed once per 16-sample sub-block
+    while a ramp is running. When the cutoffs are settled the coefficients
+    are cached and nothing is recomputed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class CutFilter
+{
+public:
+    CutFilter() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        state.resize(spec.numChannels);
+
+        lowCutHz.reset(sampleRate, smoothingSeconds);
+        highCutHz.reset(sampleRate, smoothingSeconds);
+
+        reset();
+    }
+
+    /** Clears the filter memories and jumps straight to the target cutoffs. */
+    void reset() noexcept
+    {
+        for (auto& s : state)
+            s = {};
+
+        lowCutHz.setCurrentAndTargetValue(lowCutHz.getTargetValue());
+        highCutHz.setCurrentAndTargetValue(highCutHz.getTargetValue());
+        updateCoefficients(lowCutHz.getCurrentValue(), highCutHz.getCurrentValue());
+    }
+
+    /** Sets new target cutoffs; the filter glides to them over ~50 ms. */
+    void setCutoffFrequencies(SampleType newLowCutHz, SampleType newHighCutHz) noexcept
+    {
+        const auto nyquistLimit = static_cast<SampleType>(sampleRate * 0.49);
+
+        lowCutHz.setTargetValue(juce::jlimit(SampleType(10), nyquistLimit, newLowCutHz));
+        highCutHz.setTargetValue(juce::jlimit(SampleType(10), nyquistLimit, newHighCutHz));
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto& outputBlock = context.getOutputBlock();
+        const auto numChannels = juce::jmin(outputBlock.getNumChannels(), state.size());
+        const auto numSamples = outputBlock.getNumSamples();
+
+        if (context.usesSeparateInputAndOutputBlocks())
+            outputBlock.copyFrom(context.getInputBlock());
+
+        if (context.isBypassed)
+            return;
+
+        for (size_t start = 0; start < numSamples; start += subBlockSize)
+        {
+            const auto num = juce::jmin(subBlockSize, numSamples - start);
+
+            if (lowCutHz.isSmoothing() || highCutHz.isSmoothing())
+            {
+                updateCoefficients(lowCutHz.getNextValue(), highCutHz.getNextValue());
+                lowCutHz.skip((int) num - 1);
+                highCutHz.skip((int) num - 1);
+            }
+
+            for (size_t channel = 0; channel < numChannels; ++channel)
+                processSamples(outputBlock.getChannelPointer(channel) + start, num, state[channel]);
+        }
+    }
+
+private:
+    struct SVFCoefficients
+    {
+        SampleType a1 = 1, a2 = 0, a3 = 0;
+    };
+
+    struct ChannelState
+    {
+        SampleType lowCut1 = 0, lowCut2 = 0;
+        SampleType highCut1 = 0, highCut2 = 0;
+    };
+
+    static SVFCoefficients makeCoefficients(double rate, SampleType cutoff) noexcept
+    {
+        const auto g = static_cast<SampleType>(std::tan(juce::MathConstants<double>::pi * cutoff / rate));
+
+        SVFCoefficients c;
+        c.a1 = SampleType(1) / (SampleType(1) + g * (g + k));
+        c.a2 = g * c.a1;
+        c.a3 = g * c.a2;
+        return c;
+    }
+
+    void updateCoefficients(SampleType lowCut, SampleType highCut) noexcept
+    {
+        lowCutCoeffs = makeCoefficients(sampleRate, lowCut);
+        highCutCoeffs = makeCoefficients(sampleRate, highCut);
+    }
+
+    void processSamples(SampleType* data, size_t num, ChannelState& s) const noexcept
+    {
+        const auto lc = lowCutCoeffs;
+        const auto hc = highCutCoeffs;
+
+        auto l1 = s.lowCut1, l2 = s.lowCut2;
+        auto h1 = s.highCut1, h2 = s.highCut2;
+
+        for (size_t i = 0; i < num; ++i)
+        {
+            // Highpass for the low cut
+            const auto x = data[i];
+            auto v3 = x - l2;
+            auto v1 = lc.a1 * l1 + lc.a2 * v3;
+            auto v2 = l2 + lc.a2 * l1 + lc.a3 * v3;
+            l1 = SampleType(2) * v1 - l1;
+            l2 = SampleType(2) * v2 - l2;
+            const auto highPassed = x - k * v1 - v2;
+
+            // Lowpass for the high cut
+            v3 = highPassed - h2;
+            v1 = hc.a1 * h1 + hc.a2 * v3;
+            v2 = h2 + hc.a2 * h1 + hc.a3 * v3;
+            h1 = SampleType(2) * v1 - h1;
+            h2 = SampleType(2) * v2 - h2;
+            data[i] = v2;
+        }
+
+        s.lowCut1 = l1;  s.lowCut2 = l2;
+        s.highCut1 = h1; s.highCut2 = h2;
+    }
+
+    // Butterworth damping (1/Q with Q = 1/sqrt(2)), same slope as before
+    static constexpr SampleType k = static_cast<SampleType>(1.4142135623730951);
+    static constexpr size_t subBlockSize = 16;
+    static constexpr double smoothingSeconds = 0.05;
+
+    double sampleRate = 44100.0;
+    std::vector<ChannelState> state;
+
+    juce::SmoothedValue<SampleType, juce::ValueSmoothingTypes::Multiplicative> lowCutHz { SampleType(20) };
+    juce::SmoothedValue<SampleType, juce::ValueSmoothingTypes::Multiplicative> highCutHz { SampleType(20000) };
+
+    SVFCoefficients lowCutCoeffs, highCutCoeffs;
+};
@@ -0,0 +1,302 @@
+/*
+  ==============================================================================
+
+    EarlyReflections.h
+
+    Early reflections from room geometry. A shoebox room, a source and a
+    listener give the image sources of every reflection up to the third
+    order, 62 of them. Each becomes a tap for each ear: its delay is the
+    extra path length over the direct sound, and its gain falls with
+    distance, loses the wall reflectivity per bounce, and leans towards the
+    ear on its side of the head. Each ear's taps are normalised to unit
+    energy.
+
+    The input (summed to mono, as it comes from one source) is written
+    twice into a power-of-two ring, once at its index and once a ring
+    length later. Every tap's read for a whole block is then one contiguous
+    range, and the gather and sum runs tap by tap as vectorised multiply-
+    adds over the block rather than sample by sample.
+
+    New geometry is crossfaded in over 10 ms, however the calls are split,
+    so the size control can move the walls without clicks. Geometry that
+    changes again during a fade is picked up when that fade ends.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Dimensions in metres; positions as fractions of each dimension
+struct RoomGeometry
+{
+    float width = 5.0f, depth = 7.0f, height = 3.0f;
+    float sourceX = 0.5f, sourceY = 0.75f, sourceZ = 0.45f;
+    float listenerX = 0.45f, listenerY = 0.3f, listenerZ = 0.4f;
+    float reflectivity = 0.8f;      // Pressure gain per wall bounce
+
+    bool operator==(const RoomGeometry& other) const noexcept
+    {
+        return width == other.width && depth == other.depth && height == other.height
+            && sourceX == other.sourceX && sourceY == other.sourceY && sourceZ == other.sourceZ
+            && listenerX == other.listenerX && listenerY == other.listenerY && listenerZ == other.listenerZ
+            && reflectivity == other.reflectivity;
+    }
+
+    bool operator!=(const RoomGeometry& other) const noexcept { return ! (*this == other); }
+};
+
+template <typename SampleType>
+class EarlyReflections
+{
+public:
+    static constexpr int maxOrder = 3;
+    static constexpr int maxTaps = 62;              // Image sources up to maxOrder
+    static constexpr double maxDelaySeconds = 0.15;
+    static constexpr double fadeSeconds = 0.01;
+
+    EarlyReflections() = default;
+
+    /** One or two ears; channels past the second are left to the caller. */
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        numEars = juce::jlimit(1, 2, (int) spec.numChannels);
+        maxBlockSize = juce::jmax(1, (int) spec.maximumBlockSize);
+
+        const auto maxDelay = (int) std::ceil(maxDelaySeconds * sampleRate);
+        size = juce::nextPowerOfTwo(maxDelay + maxBlockSize + 1);
+        mask = size - 1;
+        ring.assign((size_t) size * 2, SampleType(0));
+
+        fadeScratch.assign((size_t) maxBlockSize, SampleType(0));
+        fadeRamp.assign((size_t) maxBlockSize, SampleType(0));
+        fadeLength = juce::jmax(1, juce::roundToInt(fadeSeconds * sampleRate));
+
+        buildTaps(geometry, current);
+        previous = current;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill(ring.begin(), ring.end(), SampleType(0));
+        writePos = 0;
+        fading = false;
+        rebuildPending = false;
+    }
+
+    /** Rebuilds the taps only when the geometry actually changed. */
+    void setGeometry(const RoomGeometry& newGeometry) noexcept
+    {
+        if (newGeometry == geometry)
+            return;
+
+        geometry = newGeometry;
+
+        if (fading)
+            rebuildPending = true;
+        else
+            startFade();
+    }
+
+    /** Reads the first one or two channels of input and writes the
+        reflections for each ear to output. At most the prepared block size.
+    */
+    void process(const juce::dsp::AudioBlock<const SampleType>& input,
+                 const juce::dsp::AudioBlock<SampleType>& output) noexcept
+    {
+        const auto numSamples = (int) input.getNumSamples();
+        jassert(numSamples <= maxBlockSize && output.getNumSamples() >= (size_t) numSamples);
+
+        writeInput(input, numSamples);
+
+        const auto numOutputs = juce::jmin(numEars, (int) output.getNumChannels());
+
+        if (fading)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                fadeRamp[(size_t) i] = SampleType(juce::jmin(fadePos + i + 1, fadeLength)) / SampleType(fadeLength);
+        }
+
+        for (int ear = 0; ear < numOutputs; ++ear)
+        {
+            auto* out = output.getChannelPointer((size_t) ear);
+            gatherTaps(current.ears[(size_t) ear], out, numSamples);
+
+            if (fading)
+            {
+                auto* old = fadeScratch.data();
+                gatherTaps(previous.ears[(size_t) ear], old, numSamples);
+
+                juce::FloatVectorOperations::subtract(out, old, numSamples);
+                juce::FloatVectorOperations::multiply(out, fadeRamp.data(), numSamples);
+                juce::FloatVectorOperations::add(out, old, numSamples);
+            }
+        }
+
+        if (fading)
+        {
+            fadePos += numSamples;
+
+            if (fadePos >= fadeLength)
+            {
+                fading = false;
+
+                if (rebuildPending)
+                {
+                    rebuildPending = false;
+                    startFade();
+                }
+            }
+        }
+
+        writePos = (writePos + numSamples) & mask;
+    }
+
+private:
+    struct EarTaps
+    {
+        std::array<int, maxTaps> delays {};
+        std::array<SampleType, maxTaps> gains {};
+        int numTaps = 0;
+    };
+
+    struct TapSet
+    {
+        std::array<EarTaps, 2> ears;
+    };
+
+    static constexpr double speedOfSound = 343.0;   // m/s
+    static constexpr double earOffset = 0.09;       // Half the head's width, metres
+
+    void startFade() noexcept
+    {
+        previous = current;
+        buildTaps(geometry, current);
+        fadePos = 0;
+        fading = true;
+    }
+
+    void writeInput(const juce::dsp::AudioBlock<const SampleType>& input, int numSamples) noexcept
+    {
+        const auto numInputs = juce::jmin(2, (int) input.getNumChannels());
+        const auto inputGain = SampleType(1) / SampleType(juce::jmax(1, numInputs));
+        auto* data = ring.data();
+
+        // The block, mono, at writePos and mirrored a ring length later
+        for (int done = 0; done < numSamples;)
+        {
+            const auto start = (writePos + done) & mask;
+            const auto count = juce::jmin(numSamples - done, size - start);
+
+            juce::FloatVectorOperations::copyWithMultiply(data + start, input.getChannelPointer(0) + done, inputGain, count);
+
+            for (int channel = 1; channel < numInputs; ++channel)
+                juce::FloatVectorOperations::addWithMultiply(data + start, input.getChannelPointer((size_t) channel) + done, inputGain, count);
+
+            juce::FloatVectorOperations::copy(data + start + size, data + start, count);
+            done += count;
+        }
+    }
+
+    void gatherTaps(const EarTaps& taps, SampleType* out, int numSamples) const noexcept
+    {
+        if (taps.numTaps == 0)
+        {
+            juce::FloatVectorOperations::clear(out, numSamples);
+            return;
+        }
+
+        // Thanks to the mirror, each tap's block is contiguous
+        const auto* data = ring.data();
+        juce::FloatVectorOperations::copyWithMultiply(out, data + ((writePos - taps.delays[0]) & mask), taps.gains[0], numSamples);
+
+        for (int k = 1; k < taps.numTaps; ++k)
+            juce::FloatVectorOperations::addWithMultiply(out, data + ((writePos - taps.delays[(size_t) k]) & mask),
+                                                         taps.gains[(size_t) k], numSamples);
+    }
+
+    void buildTaps(const RoomGeometry& room, TapSet& taps) const noexcept
+    {
+        const double length[] = { juce::jmax(1.0f, room.width), juce::jmax(1.0f, room.depth), juce::jmax(1.0f, room.height) };
+        const double source[] = { room.sourceX * length[0], room.sourceY * length[1], room.sourceZ * length[2] };
+        const double listener[] = { room.listenerX * length[0], room.listenerY * length[1], room.listenerZ * length[2] };
+        const auto reflectivity = (double) juce::jlimit(0.0f, 0.99f, room.reflectivity);
+        const auto maxDelay = (int) (maxDelaySeconds * sampleRate);
+
+        // Image of the source after n reflections along one axis
+        auto image = [](double position, double wallDistance, int n)
+        {
+            return n * wallDistance + ((n & 1) != 0 ? wallDistance - position : position);
+        };
+
+        for (int ear = 0; ear < numEars; ++ear)
+        {
+            auto& earTaps = taps.ears[(size_t) ear];
+            earTaps.numTaps = 0;
+
+            // Ears sit either side of the listener along the width
+            const auto side = numEars == 1 ? 0.0 : (ear == 0 ? -1.0 : 1.0);
+            const double earPosition[] = { listener[0] + side * earOffset, listener[1], listener[2] };
+
+            const auto direct = juce::jmax(0.1, std::hypot(source[0] - earPosition[0],
+                                                           source[1] - earPosition[1],
+                                                           source[2] - earPosition[2]));
+            double energy = 0.0;
+
+            for (int nx = -maxOrder; nx <= maxOrder; ++nx)
+                for (int ny = -maxOrder; ny <= maxOrder; ++ny)
+                    for (int nz = -maxOrder; nz <= maxOrder; ++nz)
+                    {
+                        const auto order = std::abs(nx) + std::abs(ny) + std::abs(nz);
+
+                        if (order == 0 || order > maxOrder)
+                            continue;
+
+                        const auto dx = image(source[0], length[0], nx) - earPosition[0];
+                        const auto dy = image(source[1], length[1], ny) - earPosition[1];
+                        const auto dz = image(source[2], length[2], nz) - earPosition[2];
+                        const auto distance = std::hypot(dx, dy, dz);
+
+                        const auto delay = juce::roundToInt((distance - direct) / speedOfSound * sampleRate);
+
+                        if (delay > maxDelay)
+                            continue;
+
+                        // Louder on the near side of the head
+                        const auto shadow = 0.65 + 0.35 * side * dx / distance;
+                        const auto gain = std::pow(reflectivity, order) * direct / distance * shadow;
+
+                        earTaps.delays[(size_t) earTaps.numTaps] = juce::jmax(1, delay);
+                        earTaps.gains[(size_t) earTaps.numTaps] = (SampleType) gain;
+                        ++earTaps.numTaps;
+                        energy += gain * gain;
+                    }
+
+            if (energy > 0.0)
+            {
+                const auto normalise = (SampleType) (1.0 / std::sqrt(energy));
+
+                for (int k = 0; k < earTaps.numTaps; ++k)
+                    earTaps.gains[(size_t) k] *= normalise;
+            }
+        }
+    }
+
+    RoomGeometry geometry;
+    TapSet current, previous;
+    bool fading = false, rebuildPending = false;
+    int fadeLength = 1, fadePos = 0;
+
+    std::vector<SampleType> ring, fadeScratch, fadeRamp;
+    double sampleRate = 44100.0;
+    int numEars = 2;
+    int maxBlockSize = 1;
+    int size = 0;
+    int mask = 0;
+    int writePos = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EarlyReflections)
+};
@@ -0,0 +1,610 @@
+/*
+  ==============================================================================
+
+    FDNReverb.h
+
+    Feedback delay network tank with a Householder feedback matrix and a
+    one-pole damping filter per line.
+
+    All lines share one interleaved ring buffer (one row of NumLines samples
+    per time step), so the whole network is written with aligned SIMD stores
+    and the damping, decay gains, mixing and output taps run across lines in
+    juce::dsp::SIMDRegister lanes. The only scalar work per sample is
+    gathering each line's tap from its own delay.
+
+    Modulation sweeps each line's read position with its own phasor from a
+    QuadratureLFO, so the tail is chorused inside the loop rather than
+    amplitude-modulated at the output.
+
+    For shimmer, the feedback component along each channel's (unit length)
+    output tap pattern is crossfaded at constant power with a pitch-shifted
+    copy of the other channel's component. The shifted signal is incoherent
+    with the original, so the loop keeps its energy and the normal decay
+    still sets the tail length.
+
+    With more than two output channels, channels 2 and up tap the same
+    lines with their own sign patterns, picked from the Hadamard rows and
+    scrambled copies of them so that they overlap as little as possible
+    with L/R and with each other. An 8-line tank runs out of independent
+    directions past 5.1, so on bigger beds some of its outputs share part
+    of a pattern. The network keeps one row of line taps per sample, and
+    renderExtraOutputs() turns them into those channels afterwards. The
+    gains are stored line-major, so one scaled register adds each line into
+    a group of output channels at once, and callers can split the channels
+    across threads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GrainPitchShifter.h"
+#include "Modulation.h"
+
+template <typename SampleType, int NumLines>
+class FDNReverb
+{
+public:
+    static_assert (NumLines == 4 || NumLines == 8 || NumLines == 16, "FDN order must be 4, 8 or 16");
+
+    struct Parameters
+    {
+        SampleType decaySeconds = SampleType(2);    // RT60 of the tank
+        SampleType damping = SampleType(0.5);       // 0 = bright, 1 = dark
+        SampleType width = SampleType(1);           // Stereo width of the output
+        SampleType shimmer = SampleType(0);         // Share of the feedback that is pitch shifted
+        SampleType shimmerRatio = SampleType(2);    // Pitch ratio of the shifted feedback
+        SampleType modDepth = SampleType(0);        // 0..1 of the maximum delay sweep
+        SampleType modRate = SampleType(0.8);       // Hz
+    };
+
+    FDNReverb() = default;
+
+    /** Scales the line lengths; call before prepare(). 1.0 is a large hall. */
+    void setRoomScale(SampleType newScale) noexcept { roomScale = newScale; }
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        numExtraOutputs = juce::jlimit(0, maxExtraOutputs, (int) spec.numChannels - 2);
+        extraStride = (((size_t) numExtraOutputs + lanes - 1) / lanes) * lanes;
+
+        int longest = 0;
+        for (int i = 0; i < NumLines; ++i)
+        {
+            delaySamples[i] = juce::jmax(1, juce::roundToInt(baseDelayMs[i] * roomScale * 0.001 * sampleRate));
+            longest = juce::jmax(longest, delaySamples[i]);
+        }
+
+        maxModulation = static_cast<SampleType>(maxModulationMs * 0.001 * sampleRate);
+
+        // Longest line, plus its full sweep (the modulated delay swings from
+        // the base up to base + 2 * maxModulation) and the interpolation neighbour
+        const auto rows = juce::nextPowerOfTwo(longest + 2 * (int) std::ceil(maxModulation) + 2);
+        mask = rows - 1;
+
+        bufferStorage.allocate((size_t) (rows * stride) + lanes, true);
+        buffer = Vec::getNextSIMDAlignedPtr(bufferStorage.get());
+
+        for (int d = 0; d < numDiffusers; ++d)
+        {
+            const auto length = juce::jmax(1, juce::roundToInt(diffuserMs[d] * roomScale * 0.001 * sampleRate));
+
+            for (auto& channelDiffusers : diffusers)
+                channelDiffusers[(size_t) d].buffer.assign((size_t) length, SampleType(0));
+        }
+
+        for (auto& shifter : shifters)
+            shifter.prepare(sampleRate);
+
+        lfo.prepare(sampleRate);
+        setupDelayVectors();
+
+        extraStorage.allocate((size_t) NumLines * extraStride + lanes, true);
+        extraGains = Vec::getNextSIMDAlignedPtr(extraStorage.get());
+
+        maxBlockSize = numExtraOutputs > 0 ? (size_t) spec.maximumBlockSize : 0;
+        tapHistoryStorage.allocate(maxBlockSize * stride + lanes, true);
+        tapHistory = Vec::getNextSIMDAlignedPtr(tapHistoryStorage.get());
+        numTapHistory = 0;
+
+        setupGainPatterns();
+        lastParameters.decaySeconds = SampleType(-1);   // Force a full coefficient update
+        lastParameters.damping = SampleType(-1);
+        lastParameters.shimmer = SampleType(-1);
+        lastParameters.shimmerRatio = SampleType(-1);
+        lastParameters.modDepth = SampleType(-1);
+        setParameters(parameters);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (buffer != nullptr)
+            std::fill(buffer, buffer + (size_t) (mask + 1) * stride, SampleType(0));
+
+        for (auto& v : dampState)
+            v = Vec::expand(SampleType(0));
+
+        for (auto& channelDiffusers : diffusers)
+            for (auto& diffuser : channelDiffusers)
+                diffuser.clear();
+
+        for (auto& shifter : shifters)
+            shifter.reset();
+
+        lfo.reset();
+        writePos = 0;
+    }
+
+    void setParameters(const Parameters& newParameters) noexcept
+    {
+        parameters = newParameters;
+
+        if (sampleRate <= 0.0)
+            return;
+
+        // Decay gains only need the pow() calls when the RT60 actually moves
+        if (parameters.decaySeconds != lastParameters.decaySeconds)
+        {
+            alignas(Vec) SampleType g[stride] = {};
+            const auto rt60 = juce::jmax(SampleType(0.05), parameters.decaySeconds);
+
+            for (int i = 0; i < NumLines; ++i)
+                g[i] = static_cast<SampleType>(std::pow(10.0, -3.0 * delaySamples[i] / (rt60 * sampleRate)));
+
+            for (size_t v = 0; v < numVecs; ++v)
+                decayGain[v] = Vec::fromRawArray(g + v * lanes);
+        }
+
+        if (parameters.damping != lastParameters.damping)
+        {
+            // One-pole lowpass per line, from ~18 kHz (bright) down to ~1.2 kHz
+            const auto cutoff = 18000.0 * std::pow(1200.0 / 18000.0, (double) parameters.damping);
+            const auto coeff = static_cast<SampleType>(1.0 - std::exp(-juce::MathConstants<double>::twoPi
+                                                                       * juce::jmin(cutoff, 0.45 * sampleRate) / sampleRate));
+            for (auto& v : dampCoeff)
+                v = Vec::expand(coeff);
+        }
+
+        if (parameters.shimmer != lastParameters.shimmer)
+        {
+            const auto share = juce::jlimit(0.0, 1.0, (double) parameters.shimmer);
+            shimmerDirect = static_cast<SampleType>(std::cos(share * juce::MathConstants<double>::halfPi));
+            shimmerShifted = static_cast<SampleType>(std::sin(share * juce::MathConstants<double>::halfPi));
+        }
+
+        if (parameters.modDepth != lastParameters.modDepth)
+        {
+            modulationOn = parameters.modDepth > SampleType(0);
+            modSweep = Vec::expand(juce::jlimit(SampleType(0), SampleType(1), parameters.modDepth) * maxModulation);
+        }
+
+        lfo.setRate(parameters.modRate, modulationSpread);
+
+        if (parameters.shimmerRatio != lastParameters.shimmerRatio)
+            for (auto& shifter : shifters)
+                shifter.setRatio(parameters.shimmerRatio);
+
+        wet1 = SampleType(0.5) * (SampleType(1) + parameters.width);
+        wet2 = SampleType(0.5) * (SampleType(1) - parameters.width);
+        lastParameters = parameters;
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        processTank(context);
+
+        auto& outputBlock = context.getOutputBlock();
+
+        if (outputBlock.getNumChannels() > 2 && ! context.isBypassed)
+            renderExtraOutputs(outputBlock, 2, (int) outputBlock.getNumChannels() - 2);
+    }
+
+    /** Runs the network and writes channels 0 and 1. With more outputs, the
+        block's line taps are kept for renderExtraOutputs().
+    */
+    template <typename ProcessContext>
+    void processTank(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numChannels = outputBlock.getNumChannels();
+        const auto numSamples = outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumSamples() == numSamples);
+
+        if (numChannels == 0 || context.isBypassed)
+            return;
+
+        const auto* inL = inputBlock.getChannelPointer(0);
+        const auto* inR = inputBlock.getChannelPointer(juce::jmin((size_t) 1, inputBlock.getNumChannels() - 1));
+        auto* outL = outputBlock.getChannelPointer(0);
+        auto* outR = numChannels > 1 ? outputBlock.getChannelPointer(1) : nullptr;
+
+        const auto keepTaps = numChannels > 2 && numExtraOutputs > 0;
+        jassert(! keepTaps || numSamples <= maxBlockSize);
+        numTapHistory = keepTaps ? juce::jmin(numSamples, maxBlockSize) : 0;
+
+        const auto shimmerOn = shimmerShifted > SampleType(0);
+
+        if (shimmerOn && modulationOn)  processSamples<true, true>(inL, inR, outL, outR, numSamples);
+        else if (shimmerOn)             processSamples<true, false>(inL, inR, outL, outR, numSamples);
+        else if (modulationOn)          processSamples<false, true>(inL, inR, outL, outR, numSamples);
+        else                            processSamples<false, false>(inL, inR, outL, outR, numSamples);
+    }
+
+    /** Writes output channels [firstChannel, firstChannel + numChannels), all
+        2 or above, from the taps of the last processTank(). Disjoint ranges
+        can be rendered on different threads at once.
+    */
+    void renderExtraOutputs(juce::dsp::AudioBlock<SampleType>& block, int firstChannel, int numChannels) const noexcept
+    {
+        const auto first = juce::jmax(0, firstChannel - 2);
+        const auto last = juce::jmin(numExtraOutputs, juce::jmin((int) block.getNumChannels(), firstChannel + numChannels) - 2);
+
+        if (last <= first)
+            return;
+
+        const auto firstVec = ((size_t) first / lanes) * lanes;
+        const auto endVec = (((size_t) last + lanes - 1) / lanes) * lanes;
+        const auto numSamples = juce::jmin(numTapHistory, block.getNumSamples());
+        alignas(Vec) SampleType out[maxExtraStride] = {};
+        SampleType* channels[maxExtraOutputs] = {};
+
+        for (int e = first; e < last; ++e)
+            channels[e] = block.getChannelPointer((size_t) e + 2);
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            const auto* row = tapHistory + i * stride;
+
+            for (size_t v = firstVec; v < endVec; v += lanes)
+            {
+                auto sum = Vec::expand(SampleType(0));
+
+                for (int line = 0; line < NumLines; ++line)
+                    sum += Vec::fromRawArray(extraGains + (size_t) line * extraStride + v) * row[line];
+
+                sum.copyToRawArray(out + v);
+            }
+
+            for (int e = first; e < last; ++e)
+                channels[e][i] = out[e];
+        }
+    }
+
+private:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+    static constexpr size_t lanes = Vec::size();
+    static constexpr size_t numVecs = ((size_t) NumLines + lanes - 1) / lanes;
+    static constexpr size_t stride = numVecs * lanes;   // Row length, padded to whole registers
+    static constexpr int numDiffusers = 4;
+    static constexpr int maxExtraOutputs = 14;
+    static constexpr size_t maxExtraStride = (((size_t) maxExtraOutputs + lanes - 1) / lanes) * lanes;
+
+    template <bool WithShimmer, bool WithModulation>
+    void processSamples(const SampleType* inL, const SampleType* inR,
+                        SampleType* outL, SampleType* outR, size_t numSamples) noexcept
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            SampleType left, right;
+            processSample<WithShimmer, WithModulation>(diffuse(0, inL[i]), diffuse(1, inR[i]), left, right);
+
+            if (outR != nullptr)
+            {
+                outL[i] = left * wet1 + right * wet2;
+                outR[i] = right * wet1 + left * wet2;
+            }
+            else
+            {
+                outL[i] = (left + right) * SampleType(0.5);
+            }
+
+            // Keep the taps for the surround outputs
+            if (i < numTapHistory)
+                for (size_t v = 0; v < numVecs; ++v)
+                    Vec::fromRawArray(taps + v * lanes).copyToRawArray(tapHistory + i * stride + v * lanes);
+        }
+    }
+
+    //==============================================================================
+    struct Diffuser
+    {
+        std::vector<SampleType> buffer;
+        size_t pos = 0;
+
+        void clear() noexcept
+        {
+            std::fill(buffer.begin(), buffer.end(), SampleType(0));
+            pos = 0;
+        }
+
+        SampleType process(SampleType x) noexcept
+        {
+            constexpr auto g = SampleType(0.6);
+            const auto delayed = buffer[pos];
+            const auto v = x + g * delayed;
+            buffer[pos] = v;
+
+            if (++pos == buffer.size())
+                pos = 0;
+
+            return delayed - g * v;
+        }
+    };
+
+    SampleType diffuse(size_t channel, SampleType x) noexcept
+    {
+        for (auto& diffuser : diffusers[channel])
+            x = diffuser.process(x);
+
+        return x;
+    }
+
+    void setupGainPatterns() noexcept
+    {
+        alignas(Vec) SampleType inL[stride] = {}, inR[stride] = {}, outL[stride] = {}, outR[stride] = {};
+        alignas(Vec) SampleType pickL[stride] = {}, pickR[stride] = {};
+
+        // Each channel feeds and taps half of the lines with alternating
+        // signs, so a centred source still decorrelates between L and R.
+        const auto inScale = static_cast<SampleType>(1.0 / std::sqrt((double) NumLines));
+        const auto outScale = static_cast<SampleType>(4.0 / std::sqrt((double) NumLines));
+        const auto unitScale = static_cast<SampleType>(1.0 / std::sqrt(NumLines / 2.0));
+
+        for (int i = 0; i < NumLines; ++i)
+        {
+            const auto sign = ((i >> 1) & 1) != 0 ? SampleType(-1) : SampleType(1);
+            ((i & 1) == 0 ? inL : inR)[i] = sign * inScale;
+            ((i & 1) == 0 ? outL : outR)[i] = (((i >> 2) & 1) != 0 ? -sign : sign) * outScale;
+
+            // Unit-length output patterns for the shimmer
+            ((i & 1) == 0 ? pickL : pickR)[i] = (((i >> 2) & 1) != 0 ? -sign : sign) * unitScale;
+        }
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            inGainL[v] = Vec::fromRawArray(inL + v * lanes);
+            inGainR[v] = Vec::fromRawArray(inR + v * lanes);
+            outGainL[v] = Vec::fromRawArray(outL + v * lanes);
+            outGainR[v] = Vec::fromRawArray(outR + v * lanes);
+            pickupL[v] = Vec::fromRawArray(pickL + v * lanes);
+            pickupR[v] = Vec::fromRawArray(pickR + v * lanes);
+        }
+
+        if (numExtraOutputs == 0)
+            return;
+
+        // Candidates are the Sylvester-Hadamard rows, plain and through a
+        // scrambling sign mask. Each output greedily takes the candidate that
+        // overlaps least with L/R and the outputs already placed.
+        constexpr int numCandidates = 2 * (NumLines - 1);
+        SampleType candidates[numCandidates][NumLines] = {};
+        bool used[numCandidates] = {};
+
+        for (int c = 0; c < numCandidates; ++c)
+            for (int i = 0; i < NumLines; ++i)
+                candidates[c][i] = hadamardSign(1 + c / 2, i) * ((c & 1) != 0 ? scrambleSign(i) : SampleType(1));
+
+        auto overlap = [] (const SampleType* a, const SampleType* b)
+        {
+            SampleType dot = 0, normA = 0, normB = 0;
+
+            for (int i = 0; i < NumLines; ++i)
+            {
+                dot += a[i] * b[i];
+                normA += a[i] * a[i];
+                normB += b[i] * b[i];
+            }
+
+            return std::abs(dot) / std::sqrt(normA * normB);
+        };
+
+        const SampleType* placed[NumLines + maxExtraOutputs] = { outL, outR };
+        int numPlaced = 2;
+        const auto extraScale = outScale * static_cast<SampleType>(juce::MathConstants<double>::sqrt2 * 0.5);
+
+        for (int e = 0; e < numExtraOutputs; ++e)
+        {
+            if (std::find(std::begin(used), std::end(used), false) == std::end(used))
+                std::fill(std::begin(used), std::end(used), false);
+
+            int best = -1;
+            auto bestOverlap = SampleType(2);
+
+            for (int c = 0; c < numCandidates; ++c)
+            {
+                if (used[c])
+                    continue;
+
+                auto worst = SampleType(0);
+
+                for (int p = 0; p < numPlaced; ++p)
+                    worst = juce::jmax(worst, overlap(candidates[c], placed[p]));
+
+                if (worst < bestOverlap - SampleType(1.0e-4))
+                {
+                    best = c;
+                    bestOverlap = worst;
+                }
+            }
+
+            used[best] = true;
+            placed[numPlaced++] = candidates[best];
+
+            for (int i = 0; i < NumLines; ++i)
+                extraGains[(size_t) i * extraStride + (size_t) e] = candidates[best][i] * extraScale;
+        }
+    }
+
+    static SampleType hadamardSign(int row, int column) noexcept
+    {
+        auto bits = row & column;
+        auto parity = 0;
+
+        for (; bits != 0; bits &= bits - 1)
+            parity ^= 1;
+
+        return parity != 0 ? SampleType(-1) : SampleType(1);
+    }
+
+    // (-1)^(b0 b1 + b2 b3): a bent function for 16 lines, so a scrambled row
+    // overlaps any plain row by 1/4 (at most 1/2 with 8 or 4 lines)
+    static SampleType scrambleSign(int line) noexcept
+    {
+        const auto parity = ((line & (line >> 1)) & 1) ^ (((line >> 2) & (line >> 3)) & 1);
+        return parity != 0 ? SampleType(-1) : SampleType(1);
+    }
+
+    void setupDelayVectors() noexcept
+    {
+        alignas(Vec) SampleType d[stride] = {};
+
+        for (int i = 0; i < NumLines; ++i)
+            d[i] = static_cast<SampleType>(delaySamples[i]);
+
+        for (size_t v = 0; v < numVecs; ++v)
+            baseDelay[v] = Vec::fromRawArray(d + v * lanes);
+    }
+
+    template <bool WithShimmer, bool WithModulation>
+    inline void processSample(SampleType inL, SampleType inR, SampleType& outL, SampleType& outR) noexcept
+    {
+        if constexpr (WithModulation)
+        {
+            // Delay = base + sweep * (1 + sin), so it never drops below the base length
+            lfo.advance();
+            const auto one = Vec::expand(SampleType(1));
+
+            for (size_t v = 0; v < numVecs; ++v)
+                (baseDelay[v] + modSweep * (one + lfo.sine(v))).copyToRawArray(modDelays + v * lanes);
+
+            for (int i = 0; i < NumLines; ++i)
+            {
+                const auto whole = (int) modDelays[i];
+                const auto frac = modDelays[i] - SampleType(whole);
+                const auto a = buffer[(size_t) ((writePos - whole) & mask) * stride + (size_t) i];
+                const auto b = buffer[(size_t) ((writePos - whole - 1) & mask) * stride + (size_t) i];
+                taps[i] = a + (b - a) * frac;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < NumLines; ++i)
+                taps[i] = buffer[(size_t) ((writePos - delaySamples[i]) & mask) * stride + (size_t) i];
+        }
+
+        Vec feedback[numVecs];
+        auto sumL = Vec::expand(SampleType(0));
+        auto sumR = Vec::expand(SampleType(0));
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            const auto tap = Vec::fromRawArray(taps + v * lanes);
+            sumL += tap * outGainL[v];
+            sumR += tap * outGainR[v];
+
+            dampState[v] += (tap - dampState[v]) * dampCoeff[v];
+            feedback[v] = dampState[v] * decayGain[v];
+        }
+
+        if constexpr (WithShimmer)
+        {
+            auto pickL = Vec::expand(SampleType(0));
+            auto pickR = Vec::expand(SampleType(0));
+
+            for (size_t v = 0; v < numVecs; ++v)
+            {
+                pickL += feedback[v] * pickupL[v];
+                pickR += feedback[v] * pickupR[v];
+            }
+
+            // Cross the shifted signal over, so the rising octaves spread across the image
+            const auto componentL = pickL.sum();
+            const auto componentR = pickR.sum();
+            const auto shiftedL = shifters[0].processSample(componentL);
+            const auto shiftedR = shifters[1].processSample(componentR);
+            const auto deltaL = shimmerShifted * shiftedR + (shimmerDirect - SampleType(1)) * componentL;
+            const auto deltaR = shimmerShifted * shiftedL + (shimmerDirect - SampleType(1)) * componentR;
+
+            for (size_t v = 0; v < numVecs; ++v)
+                feedback[v] += pickupL[v] * deltaL + pickupR[v] * deltaR;
+        }
+
+        auto total = Vec::expand(SampleType(0));
+
+        for (size_t v = 0; v < numVecs; ++v)
+            total += feedback[v];
+
+        // Householder reflection: I - (2/N) * ones, one horizontal sum per sample
+        const auto reflection = Vec::expand(total.sum() * householderScale);
+        auto* row = buffer + (size_t) writePos * stride;
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            const auto next = feedback[v] - reflection + inGainL[v] * inL + inGainR[v] * inR;
+            next.copyToRawArray(row + v * lanes);
+        }
+
+        outL = sumL.sum();
+        outR = sumR.sum();
+        writePos = (writePos + 1) & mask;
+    }
+
+    //==============================================================================
+    // Mutually prime-ish line lengths, interleaved so that any 4 or 8 of them
+    // still spread across the whole range
+    static constexpr double baseDelayMs[16] = { 29.7, 101.3, 37.1, 89.3, 43.7, 79.7, 53.3, 71.9,
+                                                41.1, 97.1, 47.9, 83.9, 59.9, 73.1, 61.7, 67.3 };
+    static constexpr double diffuserMs[numDiffusers] = { 4.77, 3.59, 12.73, 9.31 };
+    static constexpr double maxModulationMs = 1.5;
+    static constexpr SampleType modulationSpread = SampleType(0.6);   // Rate spread across the lines
+    static constexpr SampleType householderScale = SampleType(2) / SampleType(NumLines);
+
+    double sampleRate = 0.0;
+    SampleType roomScale = SampleType(1);
+    Parameters parameters, lastParameters;
+    SampleType wet1 = SampleType(1), wet2 = SampleType(0);
+
+    juce::HeapBlock<SampleType> bufferStorage;
+    SampleType* buffer = nullptr;
+    int mask = 0;
+    int writePos = 0;
+    int delaySamples[NumLines] = {};
+    alignas(Vec) SampleType taps[stride] = {};      // Padding lanes stay zero
+
+    Vec decayGain[numVecs], dampCoeff[numVecs], dampState[numVecs];
+    Vec inGainL[numVecs], inGainR[numVecs], outGainL[numVecs], outGainR[numVecs];
+
+    // Modulation
+    QuadratureLFO<SampleType, NumLines> lfo;
+    Vec baseDelay[numVecs], modSweep;
+    alignas(Vec) SampleType modDelays[stride] = {};
+    SampleType maxModulation = SampleType(0);
+    bool modulationOn = false;
+
+    // Shimmer
+    Vec pickupL[numVecs], pickupR[numVecs];
+    SampleType shimmerDirect = SampleType(1), shimmerShifted = SampleType(0);
+    std::array<GrainPitchShifter<SampleType>, 2> shifters;
+
+    std::array<std::array<Diffuser, numDiffusers>, 2> diffusers;
+
+    // Surround taps: NumLines rows of extraStride gains, and one row of line
+    // taps per sample of the last block
+    int numExtraOutputs = 0;
+    size_t extraStride = 0;
+    juce::HeapBlock<SampleType> extraStorage;
+    SampleType* extraGains = nullptr;
+    juce::HeapBlock<SampleType> tapHistoryStorage;
+    SampleType* tapHistory = nullptr;
+    size_t maxBlockSize = 0;
+    size_t numTapHistory = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FDNReverb)
+};
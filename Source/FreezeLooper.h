@@ -0,0 +1,197 @@
+/*
+  ==============================================================================
+
+    FreezeLooper.h
+
+    Freeze for every tank type. While freeze is off, the wet signal is
+    recorded into a preallocated power-of-two ring. Turning freeze on keeps
+    the last couple of seconds as a loop. The wet output crossfades over to
+    the loop, and once it is fully over the tank can stop running, so a
+    frozen pad costs a ring read per sample. The loop seam is hidden by
+    crossfading the end of the loop into the audio that originally led up
+    to its start. Turning freeze off fades the loop back out over the live
+    tank.
+
+    The fades and read positions for a block are worked out once in
+    beginBlock(); process() then only touches the channels it is given, so
+    different channel ranges can run on different threads.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class FreezeLooper
+{
+public:
+    FreezeLooper() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        loopLength = juce::jmax(2, juce::roundToInt(loopSeconds * spec.sampleRate));
+        seamLength = juce::jlimit(1, loopLength / 2, juce::roundToInt(seamSeconds * spec.sampleRate));
+        engageStep = 1.0 / juce::jmax(1.0, engageSeconds * spec.sampleRate);
+        releaseStep = 1.0 / juce::jmax(1.0, releaseSeconds * spec.sampleRate);
+
+        // The loop and its seam must survive the writes made while the
+        // release fade is still reading them
+        const auto releaseLength = (int) std::ceil(1.0 / releaseStep);
+        size = juce::nextPowerOfTwo(loopLength + seamLength + releaseLength + (int) spec.maximumBlockSize + 1);
+        mask = size - 1;
+        buffer.setSize((int) spec.numChannels, size);
+
+        // Equal-power seam fade, seamTable[k] = sin(k / seamLength * pi / 2)
+        seamTable.resize((size_t) seamLength + 1);
+
+        for (int k = 0; k <= seamLength; ++k)
+            seamTable[(size_t) k] = static_cast<SampleType>(std::sin(juce::MathConstants<double>::halfPi * k / seamLength));
+
+        const auto maxBlock = (size_t) spec.maximumBlockSize;
+        liveGain.assign(maxBlock, SampleType(1));
+        loopGain.assign(maxBlock, SampleType(0));
+        bodyGain.assign(maxBlock, SampleType(1));
+        seamGain.assign(maxBlock, SampleType(0));
+        bodyIndex.assign(maxBlock, 0);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        buffer.clear();
+        writePos = 0;
+        blockWritePos = 0;
+        loopEnd = 0;
+        loopPos = 0;
+        mix = 0.0;
+        frozen = false;
+        recording = true;
+        playing = false;
+        liveMuted = false;
+    }
+
+    void setFrozen(bool shouldBeFrozen) noexcept
+    {
+        // Capture a new loop only from a fully live output; refreezing
+        // during a release keeps the loop that is still fading out
+        if (shouldBeFrozen && ! frozen && mix <= 0.0)
+        {
+            loopEnd = writePos;
+            loopPos = 0;
+        }
+
+        frozen = shouldBeFrozen;
+    }
+
+    /** False once freeze has fully faded in: the live tank isn't heard. */
+    bool isTankRunning() const noexcept { return ! frozen || mix < 1.0; }
+
+    /** True while any of the loop is audible or about to be. */
+    bool isActive() const noexcept { return frozen || mix > 0.0; }
+
+    /** Audio thread, once per block before process(). */
+    void beginBlock(int numSamples) noexcept
+    {
+        jassert(numSamples <= (int) liveGain.size());
+
+        blockWritePos = writePos;
+        recording = ! frozen;
+        playing = frozen || mix > 0.0;
+        liveMuted = frozen && mix >= 1.0;
+
+        if (playing && ! liveMuted)
+        {
+            // Equal-power fade between the live tank and the loop. Once fully
+            // frozen the mix has settled and process() ignores these gains
+            for (int i = 0; i < numSamples; ++i)
+            {
+                mix = frozen ? juce::jmin(1.0, mix + engageStep) : juce::jmax(0.0, mix - releaseStep);
+                liveGain[(size_t) i] = static_cast<SampleType>(std::cos(mix * juce::MathConstants<double>::halfPi));
+                loopGain[(size_t) i] = static_cast<SampleType>(std::sin(mix * juce::MathConstants<double>::halfPi));
+            }
+        }
+
+        if (playing)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                // Over the last seamLength samples, fade in the audio one
+                // loop earlier, which runs straight into the loop start
+                const auto seamPos = loopPos - (loopLength - seamLength);
+                bodyIndex[(size_t) i] = (loopEnd - loopLength + loopPos) & mask;
+                bodyGain[(size_t) i] = seamPos >= 0 ? seamTable[(size_t) (seamLength - seamPos)] : SampleType(1);
+                seamGain[(size_t) i] = seamPos >= 0 ? seamTable[(size_t) seamPos] : SampleType(0);
+
+                loopPos = loopPos + 1 < loopLength ? loopPos + 1 : 0;
+            }
+        }
+
+        if (recording)
+            writePos = (writePos + numSamples) & mask;
+    }
+
+    /** Mixes the loop into channels [firstChannel, firstChannel + numChannels)
+        and records them. Disjoint ranges can run on different threads.
+    */
+    void process(juce::dsp::AudioBlock<SampleType>& block, int firstChannel, int numChannels) noexcept
+    {
+        const auto numSamples = (int) block.getNumSamples();
+        const auto lastChannel = juce::jmin(firstChannel + numChannels, (int) block.getNumChannels(), buffer.getNumChannels());
+
+        for (int channel = firstChannel; channel < lastChannel; ++channel)
+        {
+            auto* data = block.getChannelPointer((size_t) channel);
+            auto* ring = buffer.getWritePointer(channel);
+
+            if (playing)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const auto body = bodyIndex[(size_t) i];
+                    const auto loopSample = ring[body] * bodyGain[(size_t) i]
+                                          + ring[(body - loopLength) & mask] * seamGain[(size_t) i];
+
+                    // A stopped tank leaves stale samples behind; don't mix them in
+                    data[i] = liveMuted ? loopSample
+                                        : data[i] * liveGain[(size_t) i] + loopSample * loopGain[(size_t) i];
+                }
+            }
+
+            if (recording)
+            {
+                const auto first = juce::jmin(numSamples, size - blockWritePos);
+                std::memcpy(ring + blockWritePos, data, sizeof(SampleType) * (size_t) first);
+                std::memcpy(ring, data + first, sizeof(SampleType) * (size_t) (numSamples - first));
+            }
+        }
+    }
+
+private:
+    static constexpr double loopSeconds = 2.0;
+    static constexpr double seamSeconds = 0.25;
+    static constexpr double engageSeconds = 0.05;
+    static constexpr double releaseSeconds = 0.3;
+
+    juce::AudioBuffer<SampleType> buffer;
+    std::vector<SampleType> seamTable;
+    int size = 0, mask = 0;
+    int loopLength = 2, seamLength = 1;
+    double engageStep = 1.0, releaseStep = 1.0;
+
+    int writePos = 0;
+    int loopEnd = 0;
+    int loopPos = 0;
+    double mix = 0.0;       // 0 = live tank, 1 = loop
+    bool frozen = false;
+
+    // Worked out by beginBlock() for process()
+    std::vector<SampleType> liveGain, loopGain, bodyGain, seamGain;
+    std::vector<int> bodyIndex;
+    int blockWritePos = 0;
+    bool recording = true, playing = false, liveMuted = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FreezeLooper)
+};
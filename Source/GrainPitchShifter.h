@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    GrainPitchShifter.h
+
+    Delay-line granular pitch shifter: two read taps sweep through a short
+    buffer at the pitch ratio, half a grain apart, each faded by a Hann
+    window so the pair always sums to unity gain. The window comes from a
+    table built in prepare(), so the per-sample path is two interpolated
+    reads and two table lookups.
+
+    The input is DC-blocked: DC is the one frequency a shifter maps onto
+    itself, so in a feedback loop it would otherwise add up coherently.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class GrainPitchShifter
+{
+public:
+    GrainPitchShifter() = default;
+
+    void prepare(double sampleRate, double grainMs = 60.0)
+    {
+        grainSize = juce::jmax(64, juce::roundToInt(grainMs * 0.001 * sampleRate));
+
+        const auto size = juce::nextPowerOfTwo(grainSize + 4);
+        mask = size - 1;
+        buffer.assign((size_t) size, SampleType(0));
+
+        // sin^2 over one grain; the extra point saves a wrap in the lookup
+        for (int i = 0; i <= windowSize; ++i)
+        {
+            const auto s = std::sin(juce::MathConstants<double>::pi * i / windowSize);
+            window[(size_t) i] = static_cast<SampleType>(s * s);
+        }
+
+        dcCoeff = static_cast<SampleType>(std::exp(-juce::MathConstants<double>::twoPi * 20.0 / sampleRate));
+
+        setRatio(ratio);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill(buffer.begin(), buffer.end(), SampleType(0));
+        writePos = 0;
+        phase = SampleType(0);
+        dcInput = dcOutput = SampleType(0);
+    }
+
+    /** 2 is an octave up, 0.5 an octave down. */
+    void setRatio(SampleType newRatio) noexcept
+    {
+        ratio = newRatio;
+
+        if (grainSize > 0)
+            increment = (SampleType(1) - ratio) / static_cast<SampleType>(grainSize);
+    }
+
+    SampleType processSample(SampleType input) noexcept
+    {
+        dcOutput = input - dcInput + dcCoeff * dcOutput;
+        dcInput = input;
+        buffer[(size_t) writePos] = dcOutput;
+
+        auto otherPhase = phase + SampleType(0.5);
+        if (otherPhase >= SampleType(1))
+            otherPhase -= SampleType(1);
+
+        const auto output = readGrain(phase) + readGrain(otherPhase);
+
+        // Shifting up makes the increment negative
+        phase += increment;
+        phase -= std::floor(phase);
+
+        writePos = (writePos + 1) & mask;
+        return output;
+    }
+
+private:
+    SampleType readGrain(SampleType grainPhase) const noexcept
+    {
+        // Window
+        // A tiny negative phase wraps to exactly 1 in floating point, which
+        // would read one past the table
+        const auto w = grainPhase * SampleType(windowSize);
+        const auto wi = juce::jmin((int) w, windowSize - 1);
+        const auto wf = w - SampleType(wi);
+        const auto gain = window[(size_t) wi] + (window[(size_t) wi + 1] - window[(size_t) wi]) * wf;
+
+        // Delay of 1 .. grainSize + 1 samples behind the write head
+        const auto readPos = SampleType(writePos) - SampleType(1) - grainPhase * SampleType(grainSize);
+        const auto floorPos = std::floor(readPos);
+        const auto frac = readPos - floorPos;
+        const auto i = (int) floorPos;
+        const auto a = buffer[(size_t) (i & mask)];
+        const auto b = buffer[(size_t) ((i + 1) & mask)];
+
+        return gain * (a + (b - a) * frac);
+    }
+
+    static constexpr int windowSize = 1024;
+
+    std::vector<SampleType> buffer;
+    std::array<SampleType, windowSize + 1> window {};
+    int mask = 0;
+    int writePos = 0;
+    int grainSize = 0;
+    SampleType ratio = SampleType(2);
+    SampleType phase = SampleType(0);
+    SampleType increment = SampleType(0);
+    SampleType dcCoeff = SampleType(0), dcInput = SampleType(0), dcOutput = SampleType(0);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GrainPitchShifter)
+};
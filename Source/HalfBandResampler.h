@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    HalfBandResampler.h
+
+    Decimates a multichannel signal by 2 or 4 and interpolates it back, with
+    a cascade of linear-phase half-band FIR stages designed by the same
+    juce::dsp::FilterDesign routine that juce::dsp::Oversampling uses.
+
+    Each stage runs polyphase: the decimator only computes the samples it
+    keeps, and the interpolator splits into a pure-delay phase and a phase
+    with the odd-offset taps. Half the taps of a half-band filter are zero
+    and the rest are symmetric, so both sides fold pairs of samples onto
+    each coefficient.
+
+    Host blocks don't have to be multiples of the factor. The decimator
+    carries any leftover input to the next block, and the up-sampled output
+    goes through a small FIFO primed with factor - 1 samples, so processUp()
+    always returns exactly as many samples as processDown() consumed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class HalfBandResampler
+{
+public:
+    HalfBandResampler() = default;
+
+    /** factor is 1, 2 or 4; at 1 the resampler is unused and adds no latency. */
+    void prepare(int numChannels, int newFactor, int maxBlockSize)
+    {
+        jassert(newFactor == 1 || newFactor == 2 || newFactor == 4);
+
+        factor = newFactor;
+        stages.clear();
+
+        // The stage at the highest rate only has to protect the band the next
+        // stage filters again, so it gets the wider (cheaper) transition
+        if (factor >= 4)
+            stages.push_back(std::make_unique<Stage>(numChannels, SampleType(0.2)));
+
+        if (factor >= 2)
+            stages.push_back(std::make_unique<Stage>(numChannels, SampleType(0.1)));
+
+        // Scratch for the intermediate rates, and the output FIFO
+        const auto maxLow = maxBlockSize / 2 + 2;
+        middle.setSize(numChannels, maxLow);
+        low.setSize(numChannels, maxLow / 2 + 2);
+        upMiddle.setSize(numChannels, juce::nextPowerOfTwo(maxLow + 4));     // Masked, so a power of two
+
+        fifoSize = juce::nextPowerOfTwo(maxBlockSize + 2 * factor + 4);
+        fifo.setSize(numChannels, fifoSize);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        for (auto& stage : stages)
+            stage->reset();
+
+        fifo.clear();
+        fifoRead = 0;
+        fifoWrite = juce::jmax(0, factor - 1);
+    }
+
+    int getFactor() const noexcept { return factor; }
+
+    /** Total round-trip latency in samples at the outer rate. */
+    int getLatencySamples() const noexcept
+    {
+        if (factor <= 1)
+            return 0;
+
+        // The FIFO's priming is cancelled by the decimator producing its
+        // output on the second sample of each pair
+        int latency = 0;
+        int rateMultiple = 1;
+
+        for (auto& stage : stages)
+        {
+            latency += 2 * stage->centre * rateMultiple;
+            rateMultiple *= 2;
+        }
+
+        return latency;
+    }
+
+    /** Decimates the input; the returned block lives until the next call.
+        It has numBlockChannels channels if that is more than the input has,
+        and the channels past the input are scratch for the caller to fill.
+    */
+    juce::dsp::AudioBlock<SampleType> processDown(const juce::dsp::AudioBlock<const SampleType>& input,
+                                                  size_t numBlockChannels = 0) noexcept
+    {
+        const auto numChannels = (int) input.getNumChannels();
+        const auto numOut = juce::jlimit((size_t) numChannels, (size_t) middle.getNumChannels(), numBlockChannels);
+        auto numMiddle = stages.front()->decimate(input, middle, numChannels);
+
+        if (stages.size() == 1)
+            return juce::dsp::AudioBlock<SampleType>(middle).getSubsetChannelBlock(0, numOut)
+                                                            .getSubBlock(0, (size_t) numMiddle);
+
+        const auto middleBlock = juce::dsp::AudioBlock<const SampleType>(middle).getSubsetChannelBlock(0, (size_t) numChannels)
+                                                                                .getSubBlock(0, (size_t) numMiddle);
+        auto numLow = stages.back()->decimate(middleBlock, low, numChannels);
+
+        return juce::dsp::AudioBlock<SampleType>(low).getSubsetChannelBlock(0, numOut)
+                                                     .getSubBlock(0, (size_t) numLow);
+    }
+
+    /** Interpolates the processed low-rate block and writes exactly
+        output.getNumSamples() samples into output.
+    */
+    void processUp(const juce::dsp::AudioBlock<const SampleType>& lowBlock,
+                   juce::dsp::AudioBlock<SampleType>& output) noexcept
+    {
+        const auto numChannels = (int) output.getNumChannels();
+        const auto numSamples = (int) output.getNumSamples();
+
+        if (stages.size() == 1)
+        {
+            stages.front()->interpolate(lowBlock, fifo, fifoWrite, fifoSize - 1, numChannels);
+        }
+        else
+        {
+            // Low -> middle rate into scratch, then middle -> outer rate into the FIFO
+            int middleWrite = 0;
+            stages.back()->interpolate(lowBlock, upMiddle, middleWrite, upMiddle.getNumSamples() - 1, numChannels);
+
+            const auto middleBlock = juce::dsp::AudioBlock<const SampleType>(upMiddle).getSubsetChannelBlock(0, (size_t) numChannels)
+                                                                                      .getSubBlock(0, (size_t) middleWrite);
+            stages.front()->interpolate(middleBlock, fifo, fifoWrite, fifoSize - 1, numChannels);
+        }
+
+        const auto fifoMask = fifoSize - 1;
+        jassert(((fifoWrite - fifoRead) & fifoMask) >= numSamples);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto* source = fifo.getReadPointer(channel);
+            auto* dest = output.getChannelPointer((size_t) channel);
+            const auto first = juce::jmin(numSamples, fifoSize - fifoRead);
+
+            std::memcpy(dest, source + fifoRead, sizeof(SampleType) * (size_t) first);
+            std::memcpy(dest + first, source, sizeof(SampleType) * (size_t) (numSamples - first));
+        }
+
+        fifoRead = (fifoRead + numSamples) & fifoMask;
+        fifoWrite &= fifoMask;
+    }
+
+private:
+    //==============================================================================
+    struct Stage
+    {
+        Stage(int numChannels, SampleType transitionWidth)
+        {
+            auto design = juce::dsp::FilterDesign<SampleType>::designFIRLowpassHalfBandEquirippleMethod(transitionWidth,
+                                                                                                       SampleType(-90));
+            const auto* h = design->getRawCoefficients();
+            const auto numTaps = (int) design->coefficients.size();
+
+            centre = (numTaps - 1) / 2;
+            jassert((centre & 1) == 1);
+
+            // Unity DC gain, whatever the designer's own scaling
+            SampleType dc = 0;
+            for (int i = 0; i < numTaps; ++i)
+                dc += h[i];
+
+            centreTap = h[centre] / dc;
+
+            for (int j = 1; j <= centre; j += 2)
+                taps.push_back(h[centre + j] / dc);
+
+            const auto historySize = juce::nextPowerOfTwo(2 * centre + 2);
+            mask = historySize - 1;
+            downHistory.setSize(numChannels, historySize);
+            upHistory.setSize(numChannels, historySize);
+        }
+
+        void reset() noexcept
+        {
+            downHistory.clear();
+            upHistory.clear();
+            downPos = upPos = 0;
+            downParity = 0;
+        }
+
+        // Two in, one out; returns the number of outputs written
+        int decimate(const juce::dsp::AudioBlock<const SampleType>& input, juce::AudioBuffer<SampleType>& output,
+                     int numChannels) noexcept
+        {
+            const auto numInput = (int) input.getNumSamples();
+            int numOutput = 0;
+            auto pos = downPos;
+            auto parity = downParity;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const auto* in = input.getChannelPointer((size_t) channel);
+                auto* history = downHistory.getWritePointer(channel);
+                auto* out = output.getWritePointer(channel);
+
+                pos = downPos;
+                parity = downParity;
+                numOutput = 0;
+
+                for (int i = 0; i < numInput; ++i)
+                {
+                    history[pos] = in[i];
+                    parity ^= 1;
+
+                    if (parity == 0)
+                    {
+                        auto sum = centreTap * history[(pos - centre) & mask];
+
+                        for (int q = 0; q < (int) taps.size(); ++q)
+                        {
+                            const auto offset = 2 * q + 1;
+                            sum += taps[(size_t) q] * (history[(pos - centre - offset) & mask]
+                                                       + history[(pos - centre + offset) & mask]);
+                        }
+
+                        out[numOutput++] = sum;
+                    }
+
+                    pos = (pos + 1) & mask;
+                }
+            }
+
+            downPos = pos;
+            downParity = parity;
+            return numOutput;
+        }
+
+        // One in, two out, appended at writePos (wrapped with outMask)
+        void interpolate(const juce::dsp::AudioBlock<const SampleType>& input, juce::AudioBuffer<SampleType>& output,
+                         int& writePos, int outMask, int numChannels) noexcept
+        {
+            const auto numInput = (int) input.getNumSamples();
+            const auto delayedTap = (centre - 1) / 2;
+            auto pos = upPos;
+            auto write = writePos;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const auto* in = input.getChannelPointer((size_t) channel);
+                auto* history = upHistory.getWritePointer(channel);
+                auto* out = output.getWritePointer(channel);
+
+                pos = upPos;
+                write = writePos;
+
+                for (int i = 0; i < numInput; ++i)
+                {
+                    history[pos] = in[i];
+
+                    SampleType even = 0;
+
+                    for (int q = 0; q < (int) taps.size(); ++q)
+                    {
+                        even += taps[(size_t) q] * (history[(pos - (centre - 2 * q - 1) / 2) & mask]
+                                                    + history[(pos - (centre + 2 * q + 1) / 2) & mask]);
+                    }
+
+                    out[write] = SampleType(2) * even;
+                    write = (write + 1) & outMask;
+                    out[write] = SampleType(2) * centreTap * history[(pos - delayedTap) & mask];
+                    write = (write + 1) & outMask;
+
+                    pos = (pos + 1) & mask;
+                }
+            }
+
+            upPos = pos;
+            writePos = write;
+        }
+
+        int centre = 0;
+        SampleType centreTap = 0;
+        std::vector<SampleType> taps;       // h[centre + 1], h[centre + 3], ...
+        juce::AudioBuffer<SampleType> downHistory, upHistory;
+        int mask = 0;
+        int downPos = 0, upPos = 0, downParity = 0;
+    };
+
+    //==============================================================================
+    int factor = 1;
+    std::vector<std::unique_ptr<Stage>> stages;     // Highest rate first
+    juce::AudioBuffer<SampleType> middle, low, upMiddle, fifo;
+    int fifoSize = 0, fifoRead = 0, fifoWrite = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HalfBandResampler)
+};
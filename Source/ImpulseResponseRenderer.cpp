@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    ImpulseResponseRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "ImpulseResponseRenderer.h"
+
+ImpulseResponseRenderer::ImpulseResponseRenderer(IKReverbAudioProcessor& sourceToFollow)
+    : juce::Thread("IKReverb IR preview"),
+      source(sourceToFollow)
+{
+    // Fixed at HIGH quality, single-threaded and fully wet; update() copies
+    // over only the settings that shape the response
+    setParameter(preview, "mix", 1.0f);
+    preview.setNonRealtime(true);
+    preview.prepareToPlay(renderSampleRate, renderBlockSize);
+
+    startThread(juce::Thread::Priority::low);
+}
+
+ImpulseResponseRenderer::~ImpulseResponseRenderer()
+{
+    stopThread(4000);
+    delete mailbox.exchange(nullptr);
+}
+
+//==============================================================================
+void ImpulseResponseRenderer::update()
+{
+    const auto snapshot = source.getParameterSnapshot();
+    const auto irPath = source.getImpulseResponsePath();
+    const auto key = makeKey(snapshot, irPath);
+
+    if (key == requestedKey || state.load(std::memory_order_acquire) != State::idle)
+        return;
+
+    // The renderer is idle, so the preview processor is ours until the
+    // request is posted
+    setParameter(preview, "size", snapshot.size);
+    setParameter(preview, "damping", snapshot.damping);
+    setParameter(preview, "predelay", snapshot.predelayMs);
+    setParameter(preview, "modulation", snapshot.modulation);
+    setParameter(preview, "lowcut", snapshot.lowCut);
+    setParameter(preview, "highcut", snapshot.highCut);
+    setParameter(preview, "type", (float) snapshot.type);
+    setParameter(preview, "interval", (float) snapshot.interval);
+
+    if (irPath != loadedIRPath)
+    {
+        if (irPath.isNotEmpty())
+            preview.loadImpulseResponse(juce::File(irPath));
+
+        loadedIRPath = irPath;
+    }
+
+    requestedKey = key;
+    pendingKey = key;
+    state.store(State::requested, std::memory_order_release);
+    notify();
+}
+
+std::unique_ptr<ImpulseResponseRenderer::Result> ImpulseResponseRenderer::takeResult()
+{
+    return std::unique_ptr<Result>(mailbox.exchange(nullptr, std::memory_order_acq_rel));
+}
+
+//==============================================================================
+void ImpulseResponseRenderer::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(-1);
+
+        auto expected = State::requested;
+
+        if (! state.compare_exchange_strong(expected, State::rendering, std::memory_order_acq_rel))
+            continue;
+
+        const auto key = pendingKey;
+        std::unique_ptr<Result> result;
+
+        auto cached = std::find_if(cache.begin(), cache.end(), [key](const auto& entry) { return entry->key == key; });
+
+        if (cached != cache.end())
+        {
+            // Most recently used goes last
+            std::rotate(cached, cached + 1, cache.end());
+            result = std::make_unique<Result>(*cache.back());
+        }
+        else if ((result = render()) != nullptr)
+        {
+            result->key = key;
+
+            if ((int) cache.size() >= maxCachedResults)
+                cache.erase(cache.begin());
+
+            cache.push_back(std::make_unique<Result>(*result));
+        }
+
+        state.store(State::idle, std::memory_order_release);
+
+        if (result != nullptr)
+            publish(std::move(result));
+    }
+}
+
+std::unique_ptr<ImpulseResponseRenderer::Result> ImpulseResponseRenderer::render()
+{
+    // A newly loaded IR is built in the background
+    while (preview.isLoadingImpulseResponse())
+    {
+        wait(20);
+
+        if (threadShouldExit())
+            return {};
+    }
+
+    preview.reset();
+
+    juce::AudioBuffer<float> block(preview.getTotalNumOutputChannels(), renderBlockSize);
+    juce::MidiBuffer midi;
+
+    const auto seconds = juce::jlimit(minSeconds, maxSeconds, preview.getTailLengthSeconds());
+    const auto numSamples = (int) (seconds * renderSampleRate);
+
+    auto result = std::make_unique<Result>();
+    result->seconds = seconds;
+    result->envelope.assign((size_t) numColumns, 0.0f);
+
+    for (int position = 0; position < numSamples; position += renderBlockSize)
+    {
+        if (threadShouldExit())
+            return {};
+
+        block.clear();
+
+        if (position == 0)
+            for (int channel = 0; channel < block.getNumChannels(); ++channel)
+                block.setSample(channel, 0, 1.0f);
+
+        preview.processBlock(block, midi);
+
+        const auto count = juce::jmin(renderBlockSize, numSamples - position);
+
+        for (int i = 0; i < count; ++i)
+        {
+            auto& column = result->envelope[(size_t) ((juce::int64) (position + i) * numColumns / numSamples)];
+
+            for (int channel = 0; channel < block.getNumChannels(); ++channel)
+                column = juce::jmax(column, std::abs(block.getSample(channel, i)));
+        }
+    }
+
+    const auto peak = *std::max_element(result->envelope.begin(), result->envelope.end());
+
+    if (peak > 0.0f)
+        for (auto& column : result->envelope)
+            column = juce::jmax(0.0f, 1.0f + juce::Decibels::gainToDecibels(column / peak, -60.0f) / 60.0f);
+
+    return result;
+}
+
+void ImpulseResponseRenderer::publish(std::unique_ptr<Result> result)
+{
+    // An older result the editor hasn't collected is simply replaced
+    delete mailbox.exchange(result.release(), std::memory_order_acq_rel);
+}
+
+//==============================================================================
+juce::uint64 ImpulseResponseRenderer::makeKey(const IKReverbAudioProcessor::ParameterSnapshot& snapshot,
+                                              const juce::String& irPath)
+{
+    // FNV-1a over the settings that change the response's shape
+    juce::uint64 hash = 14695981039346656037ull;
+
+    auto add = [&hash](const void* data, size_t numBytes)
+    {
+        for (size_t i = 0; i < numBytes; ++i)
+        {
+            hash ^= static_cast<const juce::uint8*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    const float values[] = { snapshot.size, snapshot.damping, snapshot.predelayMs,
+                             snapshot.modulation, snapshot.lowCut, snapshot.highCut };
+    const int choices[] = { snapshot.type, snapshot.interval };
+
+    add(values, sizeof(values));
+    add(choices, sizeof(choices));
+
+    // The IR only matters to the convolution type
+    if (snapshot.type == (int) IKReverbAudioProcessor::ReverbType::Convolution)
+        add(irPath.toRawUTF8(), irPath.getNumBytesAsUTF8());
+
+    return hash;
+}
+
+void ImpulseResponseRenderer::setParameter(IKReverbAudioProcessor& processor, const juce::String& parameterID, float value)
+{
+    if (auto* parameter = processor.getAPVTS().getParameter(parameterID))
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
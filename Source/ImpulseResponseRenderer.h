@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    ImpulseResponseRenderer.h
+
+    Renders the plugin's real impulse response for the editor's display.
+    A private IKReverbAudioProcessor, set up like the one on the audio
+    thread but 100% wet, is fed a unit impulse on a background thread. The
+    decay envelope is kept in a small cache keyed by a hash of the settings
+    that shape it, and handed to the editor through a one-slot atomic
+    mailbox, so the editor only repaints when a new response arrives.
+
+    The private processor is passed between the two threads through an
+    atomic state rather than a lock: the message thread only configures it
+    while the renderer is idle, and the renderer only runs it once a request
+    has been posted.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+class ImpulseResponseRenderer : private juce::Thread
+{
+public:
+    struct Result
+    {
+        juce::uint64 key = 0;
+        double seconds = 0.0;           // Time the envelope covers
+        std::vector<float> envelope;    // Peak per column, 0 = -60 dB, 1 = loudest
+    };
+
+    explicit ImpulseResponseRenderer(IKReverbAudioProcessor& source);
+    ~ImpulseResponseRenderer() override;
+
+    /** Message thread: asks for a new render if the settings changed since
+        the last request. While a render is running the request waits for
+        the next call, so call this from a timer.
+    */
+    void update();
+
+    /** Message thread: the newest finished render, or nullptr if none has
+        arrived since the last call.
+    */
+    std::unique_ptr<Result> takeResult();
+
+    static constexpr int numColumns = 256;
+
+private:
+    void run() override;
+
+    std::unique_ptr<Result> render();
+    void publish(std::unique_ptr<Result> result);
+    static juce::uint64 makeKey(const IKReverbAudioProcessor::ParameterSnapshot& snapshot, const juce::String& irPath);
+    static void setParameter(IKReverbAudioProcessor& processor, const juce::String& parameterID, float value);
+
+    static constexpr double renderSampleRate = 48000.0;
+    static constexpr int renderBlockSize = 256;
+    static constexpr double minSeconds = 0.25;
+    static constexpr double maxSeconds = 10.0;
+    static constexpr int maxCachedResults = 16;
+
+    IKReverbAudioProcessor& source;
+    IKReverbAudioProcessor preview;     // Only the thread that owns it, per state, touches it
+
+    enum class State { idle, requested, rendering };
+    std::atomic<State> state { State::idle };
+    juce::uint64 requestedKey = 0;      // Message thread
+    juce::uint64 pendingKey = 0;        // Written before state becomes requested
+    juce::String loadedIRPath;
+
+    // Renderer thread only, most recently used last
+    std::vector<std::unique_ptr<Result>> cache;
+
+    std::atomic<Result*> mailbox { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ImpulseResponseRenderer)
+};
@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    Modulation.h
+
+    QuadratureLFO: a bank of sine phasors, one per SIMD lane, advanced by a
+    complex rotation each sample. That is four multiplies per register, with
+    a cheap first-order renormalisation every few hundred samples instead of
+    any per-sample trig. The trig only runs when the rate changes.
+
+    ChorusDelay: a short per-channel modulated delay driven by a
+    QuadratureLFO, for tanks whose own delay lines can't be modulated.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType, int NumPhasors>
+class QuadratureLFO
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+    static constexpr size_t lanes = Vec::size();
+    static constexpr size_t numVecs = ((size_t) NumPhasors + lanes - 1) / lanes;
+
+    QuadratureLFO() = default;
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        lastRate = lastSpread = SampleType(-1);
+        setRate(rate, spread);
+        reset();
+    }
+
+    /** Starts every phasor again, spread evenly around the circle. */
+    void reset() noexcept
+    {
+        alignas(Vec) SampleType c[numVecs * lanes] = {}, s[numVecs * lanes] = {};
+
+        for (int i = 0; i < NumPhasors; ++i)
+        {
+            const auto angle = juce::MathConstants<double>::twoPi * i / NumPhasors;
+            c[i] = static_cast<SampleType>(std::cos(angle));
+            s[i] = static_cast<SampleType>(std::sin(angle));
+        }
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            cosState[v] = Vec::fromRawArray(c + v * lanes);
+            sinState[v] = Vec::fromRawArray(s + v * lanes);
+        }
+
+        counter = 0;
+    }
+
+    /** Phasor i runs at rateHz * (1 + spreadAmount * i / NumPhasors). */
+    void setRate(SampleType rateHz, SampleType spreadAmount = SampleType(0)) noexcept
+    {
+        rate = rateHz;
+        spread = spreadAmount;
+
+        if (sampleRate <= 0.0 || (rate == lastRate && spread == lastSpread))
+            return;
+
+        alignas(Vec) SampleType c[numVecs * lanes] = {}, s[numVecs * lanes] = {};
+
+        for (int i = 0; i < NumPhasors; ++i)
+        {
+            const auto hz = (double) rate * (1.0 + (double) spread * i / NumPhasors);
+            const auto w = juce::MathConstants<double>::twoPi * hz / sampleRate;
+            c[i] = static_cast<SampleType>(std::cos(w));
+            s[i] = static_cast<SampleType>(std::sin(w));
+        }
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            rotCos[v] = Vec::fromRawArray(c + v * lanes);
+            rotSin[v] = Vec::fromRawArray(s + v * lanes);
+        }
+
+        lastRate = rate;
+        lastSpread = spread;
+    }
+
+    /** Advances every phasor by one sample; the sines are then in sine(). */
+    inline void advance() noexcept
+    {
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            const auto c = cosState[v] * rotCos[v] - sinState[v] * rotSin[v];
+            sinState[v] = sinState[v] * rotCos[v] + cosState[v] * rotSin[v];
+            cosState[v] = c;
+        }
+
+        if (++counter == renormaliseInterval)
+        {
+            // g ~ 1 / |z| to first order, keeps the amplitude from drifting
+            const auto three = Vec::expand(SampleType(3));
+            const auto half = Vec::expand(SampleType(0.5));
+
+            for (size_t v = 0; v < numVecs; ++v)
+            {
+                const auto g = (three - (cosState[v] * cosState[v] + sinState[v] * sinState[v])) * half;
+                cosState[v] = cosState[v] * g;
+                sinState[v] = sinState[v] * g;
+            }
+
+            counter = 0;
+        }
+    }
+
+    const Vec& sine(size_t vec) const noexcept { return sinState[vec]; }
+    SampleType sineOf(int phasor) const noexcept { return sinState[(size_t) phasor / lanes].get((size_t) phasor % lanes); }
+
+private:
+    static constexpr int renormaliseInterval = 256;
+
+    double sampleRate = 0.0;
+    SampleType rate = SampleType(1), spread = SampleType(0);
+    SampleType lastRate = SampleType(-1), lastSpread = SampleType(-1);
+    Vec cosState[numVecs], sinState[numVecs], rotCos[numVecs], rotSin[numVecs];
+    int counter = 0;
+};
+
+//==============================================================================
+template <typename SampleType>
+class ChorusDelay
+{
+public:
+    ChorusDelay() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        centre = static_cast<SampleType>(centreMs * 0.001 * spec.sampleRate);
+        maxDepth = static_cast<SampleType>(maxDepthMs * 0.001 * spec.sampleRate);
+
+        const auto size = juce::nextPowerOfTwo((int) std::ceil(centre + maxDepth) + 2);
+        mask = size - 1;
+        buffer.setSize((int) spec.numChannels, size);
+
+        lfo.prepare(spec.sampleRate);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        buffer.clear();
+        writePos = 0;
+        lfo.reset();
+    }
+
+    /** depth 0..1 of the maximum sweep. */
+    void setParameters(SampleType depth, SampleType rateHz) noexcept
+    {
+        depthSamples = juce::jlimit(SampleType(0), SampleType(1), depth) * maxDepth;
+        lfo.setRate(rateHz);
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto& block = context.getOutputBlock();
+        const auto numChannels = juce::jmin((int) block.getNumChannels(), buffer.getNumChannels());
+        const auto numSamples = (int) block.getNumSamples();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            lfo.advance();
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* ring = buffer.getWritePointer(channel);
+                auto* data = block.getChannelPointer((size_t) channel);
+                ring[writePos] = data[i];
+
+                // Alternate channels sweep in opposite directions
+                const auto d = centre + depthSamples * lfo.sineOf(channel & 1);
+                const auto whole = (int) d;
+                const auto frac = d - SampleType(whole);
+                const auto a = ring[(writePos - whole) & mask];
+                const auto b = ring[(writePos - whole - 1) & mask];
+                data[i] = a + (b - a) * frac;
+            }
+
+            writePos = (writePos + 1) & mask;
+        }
+    }
+
+private:
+    static constexpr double centreMs = 7.0;
+    static constexpr double maxDepthMs = 3.0;
+
+    QuadratureLFO<SampleType, 2> lfo;
+    juce::AudioBuffer<SampleType> buffer;
+    SampleType centre = SampleType(0), maxDepth = SampleType(0), depthSamples = SampleType(0);
+    int mask = 0;
+    int writePos = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusDelay)
+};
@@ -0,0 +1,384 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include "PartitionedConvolver.h"
+
+namespace
+{
+    constexpr int maxSegmentSize = 256;
+
+    int getFFTOrder(int fftSize)
+    {
+        int order = 0;
+        while ((1 << order) < fftSize)
+            ++order;
+        return order;
+    }
+}
+
+//==============================================================================
+PartitionedConvolver::UniformStage::UniformStage(int size, const float* segment, int segmentLength)
+    : partitionSize(size),
+      fftSize(size * 2),
+      numBins(size + 1),
+      numPartitions(juce::jmax(1, (segmentLength + size - 1) / size)),
+      fft(getFFTOrder(size * 2))
+{
+    const auto spectrumSize = (size_t) numBins * 2;
+
+    irSpectra.assign(spectrumSize * (size_t) numPartitions, 0.0f);
+    inputSpectra.assign(spectrumSize * (size_t) numPartitions, 0.0f);
+    history.assign((size_t) fftSize, 0.0f);
+    fftBuffer.assign((size_t) fftSize * 2, 0.0f);
+    accumulator.assign(spectrumSize, 0.0f);
+
+    for (int p = 0; p < numPartitions; ++p)
+    {
+        std::fill(fftBuffer.begin(), fftBuffer.end(), 0.0f);
+
+        const auto offset = p * partitionSize;
+        const auto num = juce::jmin(partitionSize, segmentLength - offset);
+
+        if (num > 0)
+            std::copy(segment + offset, segment + offset + num, fftBuffer.begin());
+
+        fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+        std::copy(fftBuffer.begin(), fftBuffer.begin() + (long) spectrumSize,
+                  irSpectra.begin() + (long) (spectrumSize * (size_t) p));
+    }
+}
+
+void PartitionedConvolver::UniformStage::clear() noexcept
+{
+    std::fill(inputSpectra.begin(), inputSpectra.end(), 0.0f);
+    std::fill(history.begin(), history.end(), 0.0f);
+    fdlPos = 0;
+}
+
+void PartitionedConvolver::UniformStage::processChunk(const float* input, float* output) noexcept
+{
+    const auto spectrumSize = (size_t) numBins * 2;
+
+    // Overlap-save: transform [previous chunk | this chunk]
+    std::copy(history.begin() + partitionSize, history.end(), history.begin());
+    std::copy(input, input + partitionSize, history.begin() + partitionSize);
+
+    std::copy(history.begin(), history.end(), fftBuffer.begin());
+    std::fill(fftBuffer.begin() + fftSize, fftBuffer.end(), 0.0f);
+    fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+
+    std::copy(fftBuffer.begin(), fftBuffer.begin() + (long) spectrumSize,
+              inputSpectra.begin() + (long) (spectrumSize * (size_t) fdlPos));
+
+    // Complex multiply-accumulate over the frequency-domain delay line
+    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+    auto* acc = accumulator.data();
+
+    for (int p = 0; p < numPartitions; ++p)
+    {
+        const auto slot = (fdlPos - p + numPartitions) % numPartitions;
+        const auto* x = inputSpectra.data() + spectrumSize * (size_t) slot;
+        const auto* h = irSpectra.data() + spectrumSize * (size_t) p;
+
+        for (size_t i = 0; i < spectrumSize; i += 2)
+        {
+            acc[i]     += x[i] * h[i]     - x[i + 1] * h[i + 1];
+            acc[i + 1] += x[i] * h[i + 1] + x[i + 1] * h[i];
+        }
+    }
+
+    std::copy(accumulator.begin(), accumulator.end(), fftBuffer.begin());
+    std::fill(fftBuffer.begin() + (long) spectrumSize, fftBuffer.end(), 0.0f);
+    fft.performRealOnlyInverseTransform(fftBuffer.data());
+
+    // The second half is free of circular wrap-around
+    std::copy(fftBuffer.begin() + partitionSize, fftBuffer.begin() + fftSize, output);
+
+    fdlPos = (fdlPos + 1) % numPartitions;
+}
+
+//==============================================================================
+PartitionedConvolver::TailStage::TailStage(int partitionSize, const float* segment, int segmentLength)
+    : stage(partitionSize, segment, segmentLength)
+{
+    for (int i = 0; i < numSlots; ++i)
+    {
+        inputSlots[i].data.assign((size_t) partitionSize, 0.0f);
+        outputSlots[i].data.assign((size_t) partitionSize, 0.0f);
+    }
+
+    workerInput.assign((size_t) partitionSize, 0.0f);
+}
+
+//==============================================================================
+PartitionedConvolver::PartitionedConvolver(const float* impulseResponse, int length)
+{
+    length = juce::jmax(1, length);
+
+    // Direct-form head
+    headReversed.assign((size_t) headSize, 0.0f);
+    for (int i = 0; i < juce::jmin(headSize, length); ++i)
+        headReversed[(size_t) (headSize - 1 - i)] = impulseResponse[i];
+
+    headHistory.assign((size_t) headSize * 2, 0.0f);
+
+    // Audio-thread FFT stage, up to where the first background stage begins
+    const auto audioEnd = juce::jmin(length, tailPartitionSizes[0] * 2);
+
+    if (audioEnd > headSize)
+        audioStage = std::make_unique<UniformStage>(audioPartitionSize, impulseResponse + headSize, audioEnd - headSize);
+
+    audioInput.assign((size_t) audioPartitionSize, 0.0f);
+    audioOutput.assign((size_t) audioPartitionSize, 0.0f);
+
+    // Background stages, each starting at twice its own partition size
+    const auto numTailSizes = (int) (sizeof(tailPartitionSizes) / sizeof(tailPartitionSizes[0]));
+
+    for (int i = 0; i < numTailSizes; ++i)
+    {
+        const auto start = tailPartitionSizes[i] * 2;
+        const auto end = i + 1 < numTailSizes ? juce::jmin(length, tailPartitionSizes[i + 1] * 2) : length;
+
+        if (end > start)
+            tailStages.push_back(std::make_unique<TailStage>(tailPartitionSizes[i], impulseResponse + start, end - start));
+    }
+
+    scratch.assign((size_t) maxSegmentSize, 0.0f);
+}
+
+PartitionedConvolver::~PartitionedConvolver() = default;
+
+void PartitionedConvolver::reset() noexcept
+{
+    std::fill(headHistory.begin(), headHistory.end(), 0.0f);
+    headPos = 0;
+
+    if (audioStage != nullptr)
+        audioStage->clear();
+
+    std::fill(audioInput.begin(), audioInput.end(), 0.0f);
+    std::fill(audioOutput.begin(), audioOutput.end(), 0.0f);
+    audioFill = 0;
+
+    // Chunks published from now on carry the new epoch, which tells the
+    // worker to drop its history; anything older is ignored on the way back
+    const auto newEpoch = epoch.load(std::memory_order_relaxed) + 1;
+    epoch.store(newEpoch, std::memory_order_relaxed);
+
+    for (auto& tail : tailStages)
+    {
+        auto& slot = tail->inputSlots[tail->currentChunk % TailStage::numSlots];
+        std::fill(slot.data.begin(), slot.data.begin() + tail->fill, 0.0f);
+        tail->firstValidChunk = tail->currentChunk;
+    }
+}
+
+void PartitionedConvolver::process(float* data, int numSamples) noexcept
+{
+    for (int start = 0; start < numSamples; start += maxSegmentSize)
+    {
+        const auto num = juce::jmin(maxSegmentSize, numSamples - start);
+        auto* input = scratch.data();
+        auto* output = data + start;
+
+        std::copy(output, output + num, input);
+
+        // Head: direct convolution with the first headSize taps
+        for (int i = 0; i < num; ++i)
+        {
+            headHistory[(size_t) headPos] = input[i];
+            headHistory[(size_t) (headPos + headSize)] = input[i];
+
+            const auto* window = headHistory.data() + headPos + 1;
+            float sum = 0.0f;
+
+            for (int k = 0; k < headSize; ++k)
+                sum += window[k] * headReversed[(size_t) k];
+
+            output[i] = sum;
+
+            if (++headPos == headSize)
+                headPos = 0;
+        }
+
+        // Audio-thread FFT stage; its latency equals its start offset
+        if (audioStage != nullptr)
+        {
+            for (int done = 0; done < num;)
+            {
+                const auto todo = juce::jmin(num - done, audioPartitionSize - audioFill);
+
+                std::copy(input + done, input + done + todo, audioInput.begin() + audioFill);
+                juce::FloatVectorOperations::add(output + done, audioOutput.data() + audioFill, todo);
+
+                audioFill += todo;
+                done += todo;
+
+                if (audioFill == audioPartitionSize)
+                {
+                    audioStage->processChunk(audioInput.data(), audioOutput.data());
+                    audioFill = 0;
+                }
+            }
+        }
+
+        for (auto& tail : tailStages)
+            processTailStage(*tail, input, output, num);
+    }
+}
+
+void PartitionedConvolver::processTailStage(TailStage& tail, const float* input, float* output, int numSamples) noexcept
+{
+    const auto partitionSize = tail.stage.partitionSize;
+    const auto currentEpoch = epoch.load(std::memory_order_relaxed);
+
+    for (int done = 0; done < numSamples;)
+    {
+        auto& inSlot = tail.inputSlots[tail.currentChunk % TailStage::numSlots];
+
+        if (tail.fill == 0)
+        {
+            // Mark the slot as being rewritten before touching its data
+            inSlot.chunk.store(-1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        const auto todo = juce::jmin(numSamples - done, partitionSize - tail.fill);
+        std::copy(input + done, input + done + todo, inSlot.data.begin() + tail.fill);
+
+        // This stage starts 2 partitions into the IR, so the chunk that is
+        // due now is the one published two periods ago
+        const auto dueChunk = tail.currentChunk - 2;
+
+        if (dueChunk >= tail.firstValidChunk)
+        {
+            auto& outSlot = tail.outputSlots[dueChunk % TailStage::numSlots];
+
+            if (outSlot.chunk.load(std::memory_order_acquire) == dueChunk)
+                juce::FloatVectorOperations::add(output + done, outSlot.data.data() + tail.fill, todo);
+            else if (tail.fill == 0)
+                tailUnderruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        tail.fill += todo;
+        done += todo;
+
+        if (tail.fill == partitionSize)
+        {
+            inSlot.epoch = currentEpoch;
+            inSlot.chunk.store(tail.currentChunk, std::memory_order_release);
+            ++tail.currentChunk;
+            tail.fill = 0;
+
+            // Offline, the chunk is ready long before it is due. If the
+            // worker is still busy from before the switch, the next chunk
+            // catches up with this one
+            if (tailInline.load(std::memory_order_relaxed) && ! tailBusy.exchange(true, std::memory_order_acquire))
+            {
+                while (runTailStage(tail)) {}
+
+                tailBusy.store(false, std::memory_order_release);
+            }
+        }
+    }
+}
+
+bool PartitionedConvolver::runTailWork() noexcept
+{
+    if (tailInline.load(std::memory_order_relaxed) || tailBusy.exchange(true, std::memory_order_acquire))
+        return false;
+
+    bool didWork = false;
+
+    for (auto& tail : tailStages)
+        didWork = runTailStage(*tail) || didWork;
+
+    tailBusy.store(false, std::memory_order_release);
+    return didWork;
+}
+
+bool PartitionedConvolver::runTailStage(TailStage& tail) noexcept
+{
+    auto& inSlot = tail.inputSlots[tail.nextChunk % TailStage::numSlots];
+    const auto chunk = inSlot.chunk.load(std::memory_order_acquire);
+
+    if (chunk < tail.nextChunk)
+        return false;
+
+    std::copy(inSlot.data.begin(), inSlot.data.end(), tail.workerInput.begin());
+    const auto slotEpoch = inSlot.epoch;
+
+    // If the audio thread lapped us while we were copying, try again later
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (inSlot.chunk.load(std::memory_order_relaxed) != chunk)
+        return false;
+
+    // After a reset, or if we fell so far behind that chunks were lost,
+    // the frequency-domain history no longer lines up
+    if (chunk != tail.nextChunk || slotEpoch != tail.workerEpoch)
+    {
+        tail.stage.clear();
+        tail.workerEpoch = slotEpoch;
+    }
+
+    auto& outSlot = tail.outputSlots[chunk % TailStage::numSlots];
+    tail.stage.processChunk(tail.workerInput.data(), outSlot.data.data());
+    outSlot.chunk.store(chunk, std::memory_order_release);
+
+    tail.nextChunk = chunk + 1;
+    return true;
+}
+
+//==============================================================================
+ConvolutionTailWorker::ConvolutionTailWorker()
+    : juce::Thread("IKReverb convolution tail")
+{
+    startThread(juce::Thread::Priority::high);
+}
+
+ConvolutionTailWorker::~ConvolutionTailWorker()
+{
+    stopThread(2000);
+}
+
+void ConvolutionTailWorker::add(PartitionedConvolver* convolver)
+{
+    const juce::ScopedLock sl(lock);
+    convolvers.addIfNotAlreadyThere(convolver);
+}
+
+void ConvolutionTailWorker::remove(PartitionedConvolver* convolver)
+{
+    // Blocks until the worker is out of the convolver, so it can be deleted
+    const juce::ScopedLock sl(lock);
+    convolvers.removeFirstMatchingValue(convolver);
+}
+
+int ConvolutionTailWorker::getNumConvolvers() const
+{
+    const juce::ScopedLock sl(lock);
+    return convolvers.size();
+}
+
+void ConvolutionTailWorker::run()
+{
+    while (! threadShouldExit())
+    {
+        bool didWork = false;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            for (auto* convolver : convolvers)
+                didWork = convolver->runTailWork() || didWork;
+        }
+
+        if (! didWork)
+            wait(1);
+    }
+}
@@ -0,0 +1,160 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolver.h
+
+    Zero-latency, non-uniformly partitioned convolution of one channel with
+    one impulse response.
+
+    The IR is split into:
+      - a 64-tap direct-form head          (audio thread, no latency)
+      - a 64-sample uniform FFT stage      (audio thread, up to 2048 taps)
+      - 1024- and 8192-sample FFT stages   (ConvolutionTailWorker thread)
+
+    Each background stage starts at twice its partition size into the IR, so
+    the worker has a whole partition period to deliver a chunk before the
+    audio thread needs it. Chunks travel between the threads through small
+    rings of sequence-tagged slots, so neither side ever waits for the other;
+    a late chunk is played as silence and counted as an underrun.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class PartitionedConvolver
+{
+public:
+    PartitionedConvolver(const float* impulseResponse, int length);
+    ~PartitionedConvolver();
+
+    /** Audio thread: replaces the samples in data with their convolution. */
+    void process(float* data, int numSamples) noexcept;
+
+    /** Audio thread: clears all history. The tail stages follow lazily. */
+    void reset() noexcept;
+
+    /** Audio thread: with shouldRunInline, the tail stages run in process()
+        as soon as each chunk is complete, and the tail worker leaves this
+        convolver alone. Use it for offline rendering, which can't afford a
+        late chunk. It can change between any two blocks without losing
+        history.
+    */
+    void setTailInline(bool shouldRunInline) noexcept { tailInline.store(shouldRunInline, std::memory_order_relaxed); }
+
+    /** Worker thread: processes at most one pending chunk per tail stage.
+        Returns true if any work was done.
+    */
+    bool runTailWork() noexcept;
+
+    int getNumTailUnderruns() const noexcept { return tailUnderruns.load(std::memory_order_relaxed); }
+
+    static constexpr int headSize = 64;
+    static constexpr int audioPartitionSize = 64;
+    static constexpr int tailPartitionSizes[] = { 1024, 8192 };
+
+private:
+    //==============================================================================
+    /** Uniformly partitioned overlap-save convolution of one IR segment. */
+    struct UniformStage
+    {
+        UniformStage(int partitionSize, const float* segment, int segmentLength);
+
+        void processChunk(const float* input, float* output) noexcept;
+        void clear() noexcept;
+
+        const int partitionSize;
+        const int fftSize;
+        const int numBins;
+        const int numPartitions;
+
+        juce::dsp::FFT fft;
+        std::vector<float> irSpectra;       // numPartitions x (numBins * 2)
+        std::vector<float> inputSpectra;    // Frequency-domain delay line, same layout
+        std::vector<float> history;         // Previous + current input chunk
+        std::vector<float> fftBuffer;
+        std::vector<float> accumulator;
+        int fdlPos = 0;
+    };
+
+    //==============================================================================
+    /** A background stage and the lock-free chunk rings that feed it. */
+    struct TailStage
+    {
+        TailStage(int partitionSize, const float* segment, int segmentLength);
+
+        static constexpr int numSlots = 4;
+
+        struct Slot
+        {
+            std::vector<float> data;
+            int epoch = 0;
+            std::atomic<juce::int64> chunk { -1 };
+        };
+
+        UniformStage stage;
+        Slot inputSlots[numSlots], outputSlots[numSlots];
+
+        // Audio thread
+        juce::int64 currentChunk = 0;
+        juce::int64 firstValidChunk = 0;
+        int fill = 0;
+
+        // Worker thread
+        juce::int64 nextChunk = 0;
+        int workerEpoch = 0;
+        std::vector<float> workerInput;
+    };
+
+    void processTailStage(TailStage& tail, const float* input, float* output, int numSamples) noexcept;
+    bool runTailStage(TailStage& tail) noexcept;
+
+    //==============================================================================
+    std::vector<float> headReversed;
+    std::vector<float> headHistory;     // Two mirrored copies, so the newest headSize samples are contiguous
+    int headPos = 0;
+
+    std::unique_ptr<UniformStage> audioStage;
+    std::vector<float> audioInput, audioOutput;
+    int audioFill = 0;
+
+    std::vector<std::unique_ptr<TailStage>> tailStages;
+    std::atomic<int> epoch { 0 };
+    std::atomic<int> tailUnderruns { 0 };
+    std::atomic<bool> tailInline { false };
+    std::atomic<bool> tailBusy { false };  // Held by whichever thread is running the tail stages
+
+    std::vector<float> scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PartitionedConvolver)
+};
+
+//==============================================================================
+/**
+    One shared background thread that runs the tail stages of every
+    PartitionedConvolver in the process. Hold it through a
+    juce::SharedResourcePointer; it polls at a 1 ms cadence while idle, so the
+    audio thread never has to signal it.
+*/
+class ConvolutionTailWorker : private juce::Thread
+{
+public:
+    ConvolutionTailWorker();
+    ~ConvolutionTailWorker() override;
+
+    void add(PartitionedConvolver* convolver);
+    void remove(PartitionedConvolver* convolver);
+
+    /** How many convolvers are registered, for checking they all get removed. */
+    int getNumConvolvers() const;
+
+private:
+    void run() override;
+
+    juce::CriticalSection lock;
+    juce::Array<PartitionedConvolver*> convolvers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionTailWorker)
+};
@@ -0,0 +1,326 @@
+/*
+  ==============================================================================
+
+    PlateReverb.h
+
+    Plate tank after Dattorro's figure-eight ("Effect Design, Part 1",
+    1997). The mono input is band-limited and smeared by four input
+    diffusers, then fed into two tank halves that feed each other. Each half
+    is a modulated allpass, a delay, a damping lowpass, a second allpass and
+    a second delay. The stereo output sums taps taken all over both halves.
+    Dattorro's lengths are for 29761 Hz and are scaled to the sample rate.
+
+    Every line lives in one contiguous arena, aligned to a cache line, with
+    each line's region a power of two long. All lines share a single write
+    counter, so a read or write is the line's offset plus the counter
+    (minus the delay) masked to the line's length: no modulo and no wrap
+    branches per sample. At 48 kHz the arena is about 200 kB in float.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Modulation.h"
+
+template <typename SampleType>
+class PlateReverb
+{
+public:
+    struct Parameters
+    {
+        SampleType decaySeconds = SampleType(2);    // RT60 of the tank
+        SampleType damping = SampleType(0.5);       // 0 = bright, 1 = dark
+        SampleType width = SampleType(1);           // Stereo width of the output
+        SampleType modDepth = SampleType(0.3);      // 0..1 of the maximum excursion
+        SampleType modRate = SampleType(1);         // Hz
+    };
+
+    PlateReverb() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        const auto scale = sampleRate / dattorroRate;
+        auto scaled = [scale](double samples) { return juce::jmax(1, juce::roundToInt(samples * scale)); };
+
+        maxExcursion = static_cast<SampleType>(excursion * scale);
+
+        // Each region is a power of two, starting on a cache line
+        size_t arenaSize = 0;
+        int largest = 1;
+
+        for (int i = 0; i < numLines; ++i)
+        {
+            auto& line = layout.lines[(size_t) i];
+            line.delay = scaled(lineLengths[i]);
+
+            const auto reach = line.delay + (isModulated(i) ? (int) std::ceil(2 * maxExcursion) + 2 : 1);
+            const auto size = juce::nextPowerOfTwo(reach);
+            line.mask = size - 1;
+            line.offset = arenaSize;
+            arenaSize += (((size_t) size + cacheLineSamples - 1) / cacheLineSamples) * cacheLineSamples;
+            largest = juce::jmax(largest, size);
+        }
+
+        arenaStorage.allocate(arenaSize + cacheLineSamples, true);
+        layout.arena = juce::snapPointerToAlignment(arenaStorage.get(), cacheLineBytes);
+        layout.counterMask = largest - 1;
+        arenaLength = arenaSize;
+
+        for (int t = 0; t < numTaps; ++t)
+            layout.taps[(size_t) t] = scaled(outputTaps[t].delay);
+
+        // The decay gain is applied twice per half, so each application
+        // covers a quarter of the figure eight
+        loopSamples = 0;
+
+        for (int i = firstTankLine; i < numLines; ++i)
+            loopSamples += layout.lines[(size_t) i].delay;
+
+        lfo.prepare(sampleRate);
+        lastParameters.decaySeconds = SampleType(-1);   // Force a full coefficient update
+        lastParameters.damping = SampleType(-1);
+        setParameters(parameters);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (layout.arena != nullptr)
+            std::fill(layout.arena, layout.arena + arenaLength, SampleType(0));
+
+        bandwidthState = dampStateL = dampStateR = SampleType(0);
+        lfo.reset();
+        layout.counter = 0;
+    }
+
+    void setParameters(const Parameters& newParameters) noexcept
+    {
+        parameters = newParameters;
+
+        if (sampleRate <= 0.0)
+            return;
+
+        if (parameters.decaySeconds != lastParameters.decaySeconds)
+        {
+            const auto rt60 = juce::jmax(0.05, (double) parameters.decaySeconds);
+            decay = static_cast<SampleType>(std::pow(10.0, -3.0 * (loopSamples / 4.0) / (rt60 * sampleRate)));
+
+            // Dattorro ties the second tank diffusion to the decay
+            decayDiffusion2 = juce::jlimit(SampleType(0.25), SampleType(0.5), decay + SampleType(0.15));
+        }
+
+        if (parameters.damping != lastParameters.damping)
+        {
+            // One-pole lowpass in each half, from ~16 kHz (bright) down to ~1.5 kHz
+            const auto cutoff = 16000.0 * std::pow(1500.0 / 16000.0, (double) parameters.damping);
+            dampCoeff = static_cast<SampleType>(std::exp(-juce::MathConstants<double>::twoPi
+                                                         * juce::jmin(cutoff, 0.45 * sampleRate) / sampleRate));
+        }
+
+        modSweep = juce::jlimit(SampleType(0), SampleType(1), parameters.modDepth) * maxExcursion;
+        lfo.setRate(parameters.modRate, SampleType(0));
+        wet1 = SampleType(0.5) * (SampleType(1) + parameters.width);
+        wet2 = SampleType(0.5) * (SampleType(1) - parameters.width);
+        lastParameters = parameters;
+    }
+
+    /** Stereo (or mono) in, summed; stereo (or mono) out. */
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numChannels = outputBlock.getNumChannels();
+        const auto numSamples = outputBlock.getNumSamples();
+
+        if (numChannels == 0 || context.isBypassed)
+            return;
+
+        const auto* inL = inputBlock.getChannelPointer(0);
+        const auto* inR = inputBlock.getChannelPointer(juce::jmin((size_t) 1, inputBlock.getNumChannels() - 1));
+        auto* outL = outputBlock.getChannelPointer(0);
+        auto* outR = numChannels > 1 ? outputBlock.getChannelPointer(1) : nullptr;
+
+        // Everything the loop touches, other than the arena, in locals: the
+        // compiler can't prove the arena's stores miss the members, and
+        // would otherwise reload them after every write
+        auto tank = layout;
+        auto band = bandwidthState, dampL = dampStateL, dampR = dampStateR;
+        const auto g = decay, diffusion2 = decayDiffusion2, damp = dampCoeff;
+        const auto centre = maxExcursion, sweep = modSweep;
+        const auto mix1 = wet1, mix2 = wet2;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            lfo.advance();
+
+            // Input bandwidth and diffusion
+            band += ((inL[i] + inR[i]) * SampleType(0.5) - band) * bandwidth;
+            auto x = tank.allpass(diffuser1, band, inputDiffusion1);
+            x = tank.allpass(diffuser2, x, inputDiffusion1);
+            x = tank.allpass(diffuser3, x, inputDiffusion2);
+            x = tank.allpass(diffuser4, x, inputDiffusion2);
+
+            // Each half takes the other's output from the end of its last delay
+            const auto feedL = x + g * tank.readEnd(delay2R);
+            const auto feedR = x + g * tank.readEnd(delay2L);
+
+            auto l = tank.modulatedAllpass(modAllpassL, feedL, -decayDiffusion1, centre + sweep * lfo.sineOf(0));
+            tank.write(delay1L, l);
+            dampL = tank.readEnd(delay1L) + (dampL - tank.readEnd(delay1L)) * damp;
+            tank.write(delay2L, tank.allpass(allpassL, dampL * g, diffusion2));
+
+            auto r = tank.modulatedAllpass(modAllpassR, feedR, -decayDiffusion1, centre + sweep * lfo.sineOf(1));
+            tank.write(delay1R, r);
+            dampR = tank.readEnd(delay1R) + (dampR - tank.readEnd(delay1R)) * damp;
+            tank.write(delay2R, tank.allpass(allpassR, dampR * g, diffusion2));
+
+            // Taps from all over the figure eight, after Dattorro's table
+            const auto left = (tank.tap(0) + tank.tap(1) - tank.tap(2) + tank.tap(3)
+                               - tank.tap(4) - tank.tap(5) - tank.tap(6)) * outputGain;
+            const auto right = (tank.tap(7) + tank.tap(8) - tank.tap(9) + tank.tap(10)
+                                - tank.tap(11) - tank.tap(12) - tank.tap(13)) * outputGain;
+
+            if (outR != nullptr)
+            {
+                outL[i] = left * mix1 + right * mix2;
+                outR[i] = right * mix1 + left * mix2;
+            }
+            else
+            {
+                outL[i] = (left + right) * SampleType(0.5);
+            }
+
+            tank.advance();
+        }
+
+        layout.counter = tank.counter;
+        bandwidthState = band;
+        dampStateL = dampL;
+        dampStateR = dampR;
+    }
+
+private:
+    //==============================================================================
+    // Dattorro's lines, in arena order
+    enum LineIndex
+    {
+        diffuser1, diffuser2, diffuser3, diffuser4,
+        modAllpassL, delay1L, allpassL, delay2L,
+        modAllpassR, delay1R, allpassR, delay2R,
+        numLines
+    };
+
+    static constexpr int firstTankLine = modAllpassL;
+    static constexpr bool isModulated(int line) noexcept { return line == modAllpassL || line == modAllpassR; }
+
+    static constexpr double lineLengths[numLines] = { 142, 107, 379, 277,
+                                                      672, 4453, 1800, 3720,
+                                                      908, 4217, 2656, 3163 };
+
+    struct OutputTap
+    {
+        LineIndex line;
+        double delay;
+    };
+
+    // Left then right, signs as in process()
+    static constexpr int numTaps = 14;
+    static constexpr OutputTap outputTaps[numTaps] =
+    {
+        { delay1R,   266 }, { delay1R,  2974 }, { allpassR, 1913 }, { delay2R,  1996 },
+        { delay1L,  1990 }, { allpassL,  187 }, { delay2L,  1066 },
+        { delay1L,   353 }, { delay1L,  3627 }, { allpassL, 1228 }, { delay2L,  2673 },
+        { delay1R,  2111 }, { allpassR,  335 }, { delay2R,   121 }
+    };
+
+    struct Line
+    {
+        size_t offset = 0;
+        int mask = 0;
+        int delay = 1;
+    };
+
+    // Where each line sits in the arena, and the shared write counter
+    struct Layout
+    {
+        SampleType* arena = nullptr;
+        std::array<Line, numLines> lines;
+        std::array<int, numTaps> taps {};
+        int counter = 0;
+        int counterMask = 0;
+
+        SampleType read(int line, int delay) const noexcept
+        {
+            const auto& l = lines[(size_t) line];
+            return arena[l.offset + (size_t) ((counter - delay) & l.mask)];
+        }
+
+        SampleType readEnd(int line) const noexcept     { return read(line, lines[(size_t) line].delay); }
+        SampleType tap(int t) const noexcept            { return read(outputTaps[t].line, taps[(size_t) t]); }
+
+        void write(int line, SampleType value) noexcept
+        {
+            const auto& l = lines[(size_t) line];
+            arena[l.offset + (size_t) (counter & l.mask)] = value;
+        }
+
+        // w = x + g w[n-D], y = w[n-D] - g w
+        SampleType allpass(int line, SampleType x, SampleType g) noexcept
+        {
+            const auto delayed = readEnd(line);
+            const auto w = x + g * delayed;
+            write(line, w);
+            return delayed - g * w;
+        }
+
+        // As above, reading offset past the line's own delay
+        SampleType modulatedAllpass(int line, SampleType x, SampleType g, SampleType offset) noexcept
+        {
+            const auto delay = SampleType(lines[(size_t) line].delay) + offset;
+            const auto whole = (int) delay;
+            const auto frac = delay - SampleType(whole);
+            const auto a = read(line, whole);
+            const auto delayed = a + (read(line, whole + 1) - a) * frac;
+            const auto w = x + g * delayed;
+            write(line, w);
+            return delayed - g * w;
+        }
+
+        void advance() noexcept { counter = (counter + 1) & counterMask; }
+    };
+
+    //==============================================================================
+    static constexpr double dattorroRate = 29761.0;
+    static constexpr double excursion = 16.0;       // Samples at dattorroRate
+    static constexpr size_t cacheLineBytes = 64;
+    static constexpr size_t cacheLineSamples = cacheLineBytes / sizeof(SampleType);
+
+    static constexpr SampleType bandwidth = SampleType(0.9995);
+    static constexpr SampleType inputDiffusion1 = SampleType(0.75);
+    static constexpr SampleType inputDiffusion2 = SampleType(0.625);
+    static constexpr SampleType decayDiffusion1 = SampleType(0.7);
+    static constexpr SampleType outputGain = SampleType(0.6);
+
+    double sampleRate = 0.0;
+    Parameters parameters, lastParameters;
+
+    // The arena, one allocation for every line
+    juce::HeapBlock<SampleType> arenaStorage;
+    size_t arenaLength = 0;
+    Layout layout;
+    int loopSamples = 0;
+
+    SampleType decay = SampleType(0.5), decayDiffusion2 = SampleType(0.5), dampCoeff = SampleType(0);
+    SampleType bandwidthState = SampleType(0), dampStateL = SampleType(0), dampStateR = SampleType(0);
+    SampleType wet1 = SampleType(1), wet2 = SampleType(0);
+
+    // Modulation of the two tank allpasses, half a cycle apart
+    QuadratureLFO<SampleType, 2> lfo;
+    SampleType maxExcursion = SampleType(0), modSweep = SampleType(0);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlateReverb)
+};
@@ -51,11 +51,10 @@ IKReverbAudioProcessorEditor::IKReverbAudioProcessorEditor (IKReverbAudioProcess
     setupSlider(lowCutSlider, "LOW CUT", lowCutLabel);
     setupSlider(highCutSlider, "HIGH CUT", highCutLabel);
 
-    // Setup type selection box
-    typeBox.addItem("HALL", 1);
-    typeBox.addItem("ROOM", 2);
-    typeBox.addItem("PLATE", 3);
-    typeBox.addItem("SPACE", 4);
+    // Setup type selection box from the parameter, so the item IDs always
+    // line up with the choice indices
+    if (auto* typeChoice = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.getAPVTS().getParameter("type")))
+        typeBox.addItemList(typeChoice->choices, 1);
     typeBox.setJustificationType(juce::Justification::centred);
     typeBox.setColour(juce::ComboBox::textColourId, juce::Colours::white);
     addAndMakeVisible(typeBox);
@@ -67,6 +66,21 @@ IKReverbAudioProcessorEditor::IKReverbAudioProcessorEditor (IKReverbAudioProcess
     typeLabel.attachToComponent(&typeBox, false);
     addAndMakeVisible(typeLabel);
 
+    // IR loader, only shown for the CONVOLUTION type
+    loadIRButton.setColour(juce::TextButton::buttonColourId, juce::Colours::black.withAlpha(0.8f));
+    loadIRButton.setColour(juce::TextButton::textColourOffId, juce::Colour(255, 255, 0));  // Yellow
+    loadIRButton.onClick = [this] { chooseImpulseResponse(); };
+    addChildComponent(loadIRButton);
+    typeBox.onChange = [this] { updateImpulseResponseButton(); };
+
+    // Freeze toggle; lit while the tail is held
+    freezeButton.setClickingTogglesState(true);
+    freezeButton.setColour(juce::TextButton::buttonColourId, juce::Colours::black.withAlpha(0.8f));
+    freezeButton.setColour(juce::TextButton::buttonOnColourId, juce::Colour(255, 0, 255));  // Hot pink
+    freezeButton.setColour(juce::TextButton::textColourOffId, juce::Colour(0, 255, 255));  // Cyan
+    freezeButton.setColour(juce::TextButton::textColourOnId, juce::Colours::white);
+    addAndMakeVisible(freezeButton);
+
     // Setup parameter attachments
     auto& apvts = audioProcessor.getAPVTS();
     sizeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
@@ -81,24 +95,78 @@ IKReverbAudioProcessorEditor::IKReverbAudioProcessorEditor (IKReverbAudioProcess
         apvts, "highcut", highCutSlider);
     typeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         apvts, "type", typeBox);
+    freezeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        apvts, "freeze", freezeButton);
+
+    // Right-click the learnable controls for MIDI learn
+    for (auto* component : std::initializer_list<juce::Component*> { &sizeSlider, &mixSlider, &predelaySlider, &freezeButton })
+        component->addMouseListener(this, true);
 
     // Setup visualizer
     visualizer.setProcessor(&audioProcessor);
     addAndMakeVisible(visualizer);
 
-    // Window size
-    setSize (600, 500);
-    startTimerHz(30);
+    // Meters and spectrum
+    meterView.setProcessor(&audioProcessor);
+    addAndMakeVisible(meterView);
+
+    // Window size; the cached background covers every pixel
+    setOpaque(true);
+    setSize (600, 580);
+
+    // MIDI learn and the IR name are the only state shown outside the
+    // attachments; the processor says when they change
+    updateMidiLabels();
+    updateImpulseResponseButton();
+    audioProcessor.addChangeListener(this);
+
+    statsStartTicks = juce::Time::getHighResolutionTicks();
 }
 
 IKReverbAudioProcessorEditor::~IKReverbAudioProcessorEditor()
 {
+    audioProcessor.removeChangeListener(this);
     setLookAndFeel(nullptr);
-    stopTimer();
 }
 
 void IKReverbAudioProcessorEditor::paint (juce::Graphics& g)
 {
+    paintStartTicks = juce::Time::getHighResolutionTicks();
+
+    const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (backgroundImage.isNull() || scale != backgroundScale)
+        renderBackground(scale);
+
+    g.drawImageTransformed(backgroundImage, juce::AffineTransform::scale(1.0f / backgroundScale));
+}
+
+void IKReverbAudioProcessorEditor::paintOverChildren (juce::Graphics&)
+{
+    // Children are painted between paint() and here
+    paintTicks += juce::Time::getHighResolutionTicks() - paintStartTicks;
+    ++numPaints;
+}
+
+IKReverbAudioProcessorEditor::PaintStats IKReverbAudioProcessorEditor::getPaintStats() const
+{
+    PaintStats stats;
+    stats.numPaints = numPaints;
+    stats.paintSeconds = juce::Time::highResolutionTicksToSeconds(paintTicks);
+    stats.openSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - statsStartTicks);
+    return stats;
+}
+
+void IKReverbAudioProcessorEditor::renderBackground (float scale)
+{
+    backgroundScale = scale;
+    backgroundImage = juce::Image(juce::Image::RGB,
+                                  juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                                  juce::jmax(1, juce::roundToInt(getHeight() * scale)),
+                                  false);
+
+    juce::Graphics g(backgroundImage);
+    g.addTransform(juce::AffineTransform::scale(scale));
     drawBackground(g);
 }
 
@@ -107,15 +175,14 @@ void IKReverbAudioProcessorEditor::drawCheckerboard(juce::Graphics& g, juce::Rec
     const int squareSize = 10;
     const float alpha = 0.03f;
 
+    g.setColour(juce::Colours::white.withAlpha(alpha));
+
     for (int y = area.getY(); y < area.getBottom(); y += squareSize)
     {
         for (int x = area.getX(); x < area.getRight(); x += squareSize)
         {
             if ((x / squareSize + y / squareSize) % 2 == 0)
-            {
-                g.setColour(juce::Colours::white.withAlpha(alpha));
                 g.fillRect(x, y, squareSize, squareSize);
-            }
         }
     }
 }
@@ -160,6 +227,8 @@ void IKReverbAudioProcessorEditor::drawBackground(juce::Graphics& g)
 
 void IKReverbAudioProcessorEditor::resized()
 {
+    backgroundImage = {};
+
     auto bounds = getLocalBounds().reduced(20);
     auto topSection = bounds.removeFromTop(80);
 
@@ -170,9 +239,14 @@ void IKReverbAudioProcessorEditor::resized()
     // Visualizer
     visualizer.setBounds(bounds.removeFromTop(100));
 
+    // Meters and spectrum
+    meterView.setBounds(bounds.removeFromTop(80).withTrimmedTop(6));
+
     // Type selection box - smaller and at the top
     auto typeBoxBounds = bounds.removeFromTop(40);
     typeBox.setBounds(typeBoxBounds.reduced(typeBoxBounds.getWidth() / 3, 5));
+    freezeButton.setBounds(typeBoxBounds.removeFromLeft(typeBoxBounds.getWidth() / 3).reduced(10, 5));
+    loadIRButton.setBounds(typeBoxBounds.removeFromRight(typeBoxBounds.getWidth() / 2).reduced(10, 5));
 
     // Controls section - now in two rows
     auto controlsArea = bounds.reduced(10, 10);
@@ -193,7 +267,100 @@ void IKReverbAudioProcessorEditor::resized()
     highCutSlider.setBounds(bottomRow.removeFromLeft(sliderWidth).reduced(5));
 }
 
-void IKReverbAudioProcessorEditor::timerCallback()
+void IKReverbAudioProcessorEditor::chooseImpulseResponse()
 {
-    repaint();
+    irChooser = std::make_unique<juce::FileChooser>("Load Impulse Response", juce::File(), "*.wav;*.aif;*.aiff;*.flac");
+
+    irChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                           [this](const juce::FileChooser& chooser)
+                           {
+                               auto file = chooser.getResult();
+                               if (file.existsAsFile())
+                                   audioProcessor.loadImpulseResponse(file);
+                           });
+}
+
+void IKReverbAudioProcessorEditor::mouseDown (const juce::MouseEvent& e)
+{
+    if (! e.mods.isPopupMenu())
+        return;
+
+    auto parameterID = getLearnableParameterID(e.eventComponent);
+
+    if (parameterID.isNotEmpty())
+        showMidiLearnMenu(parameterID);
+}
+
+juce::String IKReverbAudioProcessorEditor::getLearnableParameterID (juce::Component* component) const
+{
+    // Clicks can land on a child, such as a slider's text box
+    for (; component != nullptr && component != this; component = component->getParentComponent())
+    {
+        if (component == &sizeSlider)       return "size";
+        if (component == &mixSlider)        return "mix";
+        if (component == &predelaySlider)   return "predelay";
+        if (component == &freezeButton)     return "freeze";
+    }
+
+    return {};
+}
+
+void IKReverbAudioProcessorEditor::showMidiLearnMenu (const juce::String& parameterID)
+{
+    auto controller = audioProcessor.getMidiController(parameterID);
+
+    juce::PopupMenu menu;
+    menu.addItem(1, audioProcessor.isMidiLearning(parameterID) ? "Cancel MIDI Learn" : "MIDI Learn");
+    menu.addItem(2, controller >= 0 ? "Clear CC " + juce::String(controller) : "Clear MIDI CC", controller >= 0);
+
+    menu.showMenuAsync(juce::PopupMenu::Options(),
+                       [safeThis = juce::Component::SafePointer<IKReverbAudioProcessorEditor>(this), parameterID](int result)
+                       {
+                           if (safeThis == nullptr)
+                               return;
+
+                           auto& processor = safeThis->audioProcessor;
+
+                           if (result == 1 && processor.isMidiLearning(parameterID))
+                               processor.cancelMidiLearn();
+                           else if (result == 1)
+                               processor.beginMidiLearn(parameterID);
+                           else if (result == 2)
+                               processor.clearMidiMapping(parameterID);
+                       });
+}
+
+juce::String IKReverbAudioProcessorEditor::getMidiLabel (const juce::String& name, const juce::String& parameterID) const
+{
+    if (audioProcessor.isMidiLearning(parameterID))
+        return name + " (LEARN)";
+
+    auto controller = audioProcessor.getMidiController(parameterID);
+    return controller >= 0 ? name + " CC" + juce::String(controller) : name;
+}
+
+void IKReverbAudioProcessorEditor::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    updateMidiLabels();
+    updateImpulseResponseButton();
+}
+
+void IKReverbAudioProcessorEditor::updateMidiLabels()
+{
+    sizeLabel.setText(getMidiLabel("SIZE", "size"), juce::dontSendNotification);
+    mixLabel.setText(getMidiLabel("MIX", "mix"), juce::dontSendNotification);
+    predelayLabel.setText(getMidiLabel("PREDELAY", "predelay"), juce::dontSendNotification);
+    freezeButton.setButtonText(getMidiLabel("FREEZE", "freeze"));
+}
+
+void IKReverbAudioProcessorEditor::updateImpulseResponseButton()
+{
+    auto isConvolution = typeBox.getSelectedItemIndex() == (int) IKReverbAudioProcessor::ReverbType::Convolution;
+    loadIRButton.setVisible(isConvolution);
+
+    if (isConvolution)
+    {
+        auto irName = audioProcessor.getImpulseResponseName();
+        loadIRButton.setButtonText(irName.isNotEmpty() ? irName.toUpperCase() : "LOAD IR");
+    }
 }
@@ -10,6 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "ImpulseResponseRenderer.h"
 
 class IKReverbLookAndFeel : public juce::LookAndFeel_V4
 {
@@ -115,17 +116,30 @@ public:
     }
 };
 
+// Shows the plugin's real impulse response, rendered in the background by
+// a private copy of the DSP. The timer only checks for changed settings and
+// finished renders; the component repaints when a new response arrives
 class ReverbVisualizer : public juce::Component, public juce::Timer
 {
 public:
-    ReverbVisualizer() : processor(nullptr)
-    {
-        startTimerHz(30); // Update at 30fps
-    }
+    ReverbVisualizer() = default;
 
     void setProcessor(IKReverbAudioProcessor* p)
     {
-        processor = p;
+        renderer.reset();
+        result.reset();
+
+        if (p != nullptr)
+        {
+            renderer = std::make_unique<ImpulseResponseRenderer>(*p);
+            startTimerHz(10);
+        }
+        else
+        {
+            stopTimer();
+        }
+
+        repaint();
     }
 
     void paint(juce::Graphics& g) override
@@ -148,35 +162,21 @@ public:
             g.drawHorizontalLine(int(yPos), bounds.getX(), bounds.getRight());
         }
 
-        // Draw impulse response visualization
-        if (processor)
+        // Draw the decay envelope, 60 dB top to bottom
+        if (result != nullptr && ! result->envelope.empty())
         {
             juce::Path curve;
-            const int numPoints = 512;
-            bool first = true;
-
-            auto type = static_cast<int>(processor->getAPVTS().getParameter("type")->getValue() * 4.0f);
-            float size = processor->getAPVTS().getParameter("size")->getValue();
-            float damping = processor->getAPVTS().getParameter("damping")->getValue();
+            const auto numPoints = (int) result->envelope.size();
 
             for (int i = 0; i < numPoints; ++i)
             {
-                float x = i / float(numPoints - 1);
-                float y = std::exp(-x * (5.0f + damping * 10.0f)) * std::sin(x * 50.0f * (1.0f + size));
-                y = y * 0.5f + 0.5f; // Normalize to 0-1
+                float xPos = bounds.getX() + i / float(juce::jmax(1, numPoints - 1)) * bounds.getWidth();
+                float yPos = bounds.getBottom() - result->envelope[(size_t) i] * bounds.getHeight();
 
-                float xPos = bounds.getX() + x * bounds.getWidth();
-                float yPos = bounds.getBottom() - y * bounds.getHeight();
-
-                if (first)
-                {
+                if (i == 0)
                     curve.startNewSubPath(xPos, yPos);
-                    first = false;
-                }
                 else
-                {
                     curve.lineTo(xPos, yPos);
-                }
             }
 
             // Draw curve with glow effect
@@ -188,32 +188,263 @@ public:
             
             g.setColour(juce::Colours::cyan);
             g.strokePath(curve, juce::PathStrokeType(1.0f));
+
+            // Time span of the plot
+            g.setFont(11.0f);
+            g.drawText(juce::String(result->seconds, 1) + " s", bounds.reduced(4.0f), juce::Justification::topRight);
         }
     }
 
     void timerCallback() override
     {
-        repaint();
+        renderer->update();
+
+        if (auto next = renderer->takeResult())
+        {
+            result = std::move(next);
+            repaint();
+        }
     }
 
 private:
-    IKReverbAudioProcessor* processor;
+    std::unique_ptr<ImpulseResponseRenderer> renderer;
+    std::unique_ptr<ImpulseResponseRenderer::Result> result;
 };
 
+// Input, wet and output meters beside a spectrum of the wet signal, fed by
+// the processor's telemetry queues. Measuring is only switched on while
+// this is attached, and it only repaints while something on it moves
+class MeterView : public juce::Component, public juce::Timer
+{
+public:
+    MeterView()
+        : fft(fftOrder),
+          window((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann)
+    {
+        history.assign((size_t) fftSize, 0.0f);
+        fftData.assign((size_t) fftSize * 2, 0.0f);
+        streamBuffer.assign((size_t) fftSize, 0.0f);
+        bars.fill(0.0f);
+        peaks.fill(0.0f);
+        levels.fill(0.0f);
+    }
+
+    ~MeterView() override
+    {
+        setProcessor(nullptr);
+    }
+
+    void setProcessor(IKReverbAudioProcessor* p)
+    {
+        if (processor != nullptr)
+            processor->getTelemetry().setEnabled(false);
+
+        processor = p;
+
+        if (processor != nullptr)
+        {
+            // Drop whatever was left from an earlier editor
+            auto& telemetry = processor->getTelemetry();
+            Telemetry::LevelFrame frame;
+            while (telemetry.popLevels(&frame, 1) > 0) {}
+            while (telemetry.popWetStream(streamBuffer.data(), fftSize) > 0) {}
+
+            telemetry.setEnabled(true);
+            startTimerHz(30);
+        }
+        else
+        {
+            stopTimer();
+        }
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colours::black.withAlpha(0.3f));
+
+        auto bounds = getLocalBounds().toFloat().reduced(4);
+        auto meterArea = bounds.removeFromRight(90.0f);
+        bounds.removeFromRight(6.0f);
+
+        // Spectrum bars, 0 to -80 dB
+        auto barWidth = bounds.getWidth() / numBars;
+
+        for (int bar = 0; bar < numBars; ++bar)
+        {
+            auto height = bars[(size_t) bar] * bounds.getHeight();
+            auto area = juce::Rectangle<float>(bounds.getX() + bar * barWidth, bounds.getBottom() - height,
+                                               barWidth - 1.0f, height);
+
+            g.setGradientFill(juce::ColourGradient(juce::Colour(255, 0, 255), area.getX(), bounds.getY(),
+                                                   juce::Colour(0, 255, 255), area.getX(), bounds.getBottom(), false));
+            g.fillRect(area);
+        }
+
+        // Meters: RMS fill with a peak line, 0 to -60 dB
+        static constexpr const char* names[] = { "IN", "WET", "OUT" };
+        auto meterWidth = meterArea.getWidth() / Telemetry::numStages;
+
+        for (int stage = 0; stage < Telemetry::numStages; ++stage)
+        {
+            auto area = meterArea.removeFromLeft(meterWidth).reduced(3.0f, 0.0f);
+            auto label = area.removeFromBottom(12.0f);
+
+            g.setColour(juce::Colours::white.withAlpha(0.1f));
+            g.fillRect(area);
+
+            g.setColour(juce::Colour(0, 255, 255));
+            g.fillRect(area.withTop(area.getBottom() - levels[(size_t) stage] * area.getHeight()));
+
+            g.setColour(juce::Colour(255, 255, 0));
+            g.fillRect(area.withTop(area.getBottom() - peaks[(size_t) stage] * area.getHeight()).withHeight(2.0f));
+
+            g.setColour(juce::Colours::white);
+            g.setFont(10.0f);
+            g.drawText(names[stage], label, juce::Justification::centred);
+        }
+    }
+
+    void timerCallback() override
+    {
+        auto& telemetry = processor->getTelemetry();
+        bool changed = false;
+
+        // Levels: the loudest frame since the last tick; the display falls
+        // back at a fixed rate
+        std::array<float, Telemetry::numStages> newPeaks {}, newLevels {};
+        Telemetry::LevelFrame frames[16];
+
+        for (int numFrames; (numFrames = telemetry.popLevels(frames, 16)) > 0;)
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                for (size_t stage = 0; stage < newPeaks.size(); ++stage)
+                {
+                    newPeaks[stage] = juce::jmax(newPeaks[stage], frames[i].peak[stage]);
+                    newLevels[stage] = juce::jmax(newLevels[stage], frames[i].rms[stage]);
+                }
+            }
+        }
+
+        for (size_t stage = 0; stage < newPeaks.size(); ++stage)
+        {
+            changed = follow(peaks[stage], toDisplay(newPeaks[stage], 60.0f)) || changed;
+            changed = follow(levels[stage], toDisplay(newLevels[stage], 60.0f)) || changed;
+        }
+
+        // Spectrum of the newest fftSize samples, if any arrived
+        int numNew = 0;
+
+        for (int count; (count = telemetry.popWetStream(streamBuffer.data(), fftSize)) > 0; numNew += count)
+        {
+            std::move(history.begin() + count, history.end(), history.begin());
+            std::copy(streamBuffer.begin(), streamBuffer.begin() + count, history.end() - count);
+        }
+
+        std::array<float, numBars> newBars {};
+
+        if (numNew > 0)
+        {
+            std::copy(history.begin(), history.end(), fftData.begin());
+            std::fill(fftData.begin() + fftSize, fftData.end(), 0.0f);
+            window.multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            // Log-spaced bars from 30 Hz; a full-scale sine reads 0 dB
+            const auto binHz = telemetry.getStreamSampleRate() / fftSize;
+            const auto topHz = juce::jmin(20000.0, telemetry.getStreamSampleRate() * 0.5);
+
+            for (int bar = 0; bar < numBars; ++bar)
+            {
+                const auto lowHz = 30.0 * std::pow(topHz / 30.0, bar / (double) numBars);
+                const auto highHz = 30.0 * std::pow(topHz / 30.0, (bar + 1) / (double) numBars);
+                const auto lowBin = juce::jlimit(1, fftSize / 2, (int) (lowHz / binHz));
+                const auto highBin = juce::jlimit(lowBin + 1, fftSize / 2 + 1, (int) (highHz / binHz) + 1);
+
+                auto magnitude = 0.0f;
+                for (int bin = lowBin; bin < highBin; ++bin)
+                    magnitude = juce::jmax(magnitude, fftData[(size_t) bin]);
+
+                newBars[(size_t) bar] = toDisplay(magnitude / (fftSize * 0.25f), 80.0f);
+            }
+        }
+
+        for (size_t bar = 0; bar < newBars.size(); ++bar)
+            changed = follow(bars[bar], newBars[bar]) || changed;
+
+        if (changed)
+            repaint();
+    }
+
+private:
+    // 0 at -range dB, 1 at 0 dB
+    static float toDisplay(float gain, float range)
+    {
+        return juce::jlimit(0.0f, 1.0f, 1.0f + juce::Decibels::gainToDecibels(gain, -range) / range);
+    }
+
+    // Jumps up, falls back; returns true if the displayed value moved
+    static bool follow(float& value, float target)
+    {
+        const auto next = juce::jmax(target, value - fallPerTick);
+        const auto moved = std::abs(next - value) > 1.0e-3f;
+        value = next;
+        return moved;
+    }
+
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int numBars = 48;
+    static constexpr float fallPerTick = 0.02f;
+
+    IKReverbAudioProcessor* processor = nullptr;
+
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+    std::vector<float> history, fftData, streamBuffer;
+    std::array<float, numBars> bars;
+    std::array<float, Telemetry::numStages> peaks, levels;
+};
+
+// Redraws only on change: controls repaint themselves, and the MIDI learn
+// labels and IR name follow the processor's change messages
 class IKReverbAudioProcessorEditor : public juce::AudioProcessorEditor,
-                                   public juce::Timer
+                                   private juce::ChangeListener
 {
 public:
     IKReverbAudioProcessorEditor (IKReverbAudioProcessor&);
     ~IKReverbAudioProcessorEditor() override;
 
     void paint (juce::Graphics&) override;
+    void paintOverChildren (juce::Graphics&) override;
     void resized() override;
-    void timerCallback() override;
+    void mouseDown (const juce::MouseEvent&) override;
+
+    // What painting has cost since the editor opened; ikreverb_bench
+    // reports it
+    struct PaintStats
+    {
+        int numPaints = 0;
+        double paintSeconds = 0.0;
+        double openSeconds = 0.0;
+    };
+
+    PaintStats getPaintStats() const;
 
 private:
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;
+    void updateMidiLabels();
+    void updateImpulseResponseButton();
+
+    // Right-click MIDI learn for the learnable controls
+    juce::String getLearnableParameterID (juce::Component* component) const;
+    void showMidiLearnMenu (const juce::String& parameterID);
+    juce::String getMidiLabel (const juce::String& name, const juce::String& parameterID) const;
+
     void drawCheckerboard(juce::Graphics& g, juce::Rectangle<int> area);
     void drawBackground(juce::Graphics& g);
+    void renderBackground(float scale);
+    void chooseImpulseResponse();
 
     IKReverbAudioProcessor& audioProcessor;
     IKReverbLookAndFeel customLookAndFeel;
@@ -224,6 +455,9 @@ private:
     juce::Slider lowCutSlider;
     juce::Slider highCutSlider;
     juce::ComboBox typeBox;
+    juce::TextButton loadIRButton { "LOAD IR" };
+    juce::TextButton freezeButton { "FREEZE" };
+    std::unique_ptr<juce::FileChooser> irChooser;
 
     juce::Label titleLabel;
     juce::Label subtitleLabel;
@@ -240,8 +474,20 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> lowCutAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> highCutAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> typeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> freezeAttachment;
 
     ReverbVisualizer visualizer;
+    MeterView meterView;
+
+    // The static background, drawn once per size and display scale
+    juce::Image backgroundImage;
+    float backgroundScale = 0.0f;
+
+    // Time spent painting, for getPaintStats()
+    juce::int64 paintStartTicks = 0;
+    juce::int64 paintTicks = 0;
+    juce::int64 statsStartTicks = 0;
+    int numPaints = 0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (IKReverbAudioProcessorEditor)
 };
@@ -8,7 +8,9 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeSafetyChecker.h"
 #include <cmath>
+#include <limits>
 
 juce::AudioProcessorValueTreeState::ParameterLayout IKReverbAudioProcessor::createParameterLayout()
 {
@@ -29,9 +31,17 @@ juce::AudioProcessorValueTreeState::ParameterLayout IKReverbAudioProcessor::crea
     layout.add(std::make_unique<juce::AudioParameterChoice>(
         "type",
         "Type",
-        juce::StringArray {"ROOM", "HALL", "PLATE", "SPRING", "SHIMMER"},
+        juce::StringArray {"ROOM", "HALL", "PLATE", "SPRING", "SHIMMER", "CONVOLUTION"},
         0));
 
+    // Shimmer pitch interval; unison is left out because an unshifted
+    // feedback copy would add up coherently instead of shimmering
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "interval",
+        "Shimmer Interval",
+        juce::StringArray {"-12", "+5", "+7", "+12", "+19", "+24"},
+        3));
+
     layout.add(std::make_unique<juce::AudioParameterFloat>(
         "predelay",
         "Pre-Delay",
@@ -50,6 +60,15 @@ juce::AudioProcessorValueTreeState::ParameterLayout IKReverbAudioProcessor::crea
         juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f),
         0.0f));
 
+    // Not automatable: switching changes the latency, which takes effect on
+    // the next prepareToPlay
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "quality",
+        "Quality",
+        juce::StringArray {"HIGH", "ECO"},
+        0,
+        juce::AudioParameterChoiceAttributes().withAutomatable(false)));
+
     layout.add(std::make_unique<juce::AudioParameterFloat>(
         "lowcut",
         "Low Cut",
@@ -62,6 +81,20 @@ juce::AudioProcessorValueTreeState::ParameterLayout IKReverbAudioProcessor::crea
         juce::NormalisableRange<float>(1000.0f, 20000.0f, 1.0f, 0.3f),
         20000.0f));
 
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        "freeze",
+        "Freeze",
+        false));
+
+    // Not automatable: it only changes which threads do the work, never
+    // the sound
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "threading",
+        "Threading",
+        juce::StringArray {"SINGLE", "MULTI"},
+        0,
+        juce::AudioParameterChoiceAttributes().withAutomatable(false)));
+
     return layout;
 }
 
@@ -74,15 +107,51 @@ IKReverbAudioProcessor::IKReverbAudioProcessor()
 {
     reverbParams.roomSize = 0.5f;
     reverbParams.damping = 0.5f;
-    reverbParams.wetLevel = 0.33f;
-    reverbParams.dryLevel = 0.67f;
+    reverbParams.wetLevel = 1.0f;
+    reverbParams.dryLevel = 0.0f;
     reverbParams.width = 1.0f;
     reverbParams.freezeMode = 0.0f;
     reverb.setParameters(reverbParams);
+
+    parameters.size = apvts.getRawParameterValue("size");
+    parameters.damping = apvts.getRawParameterValue("damping");
+    parameters.type = apvts.getRawParameterValue("type");
+    parameters.interval = apvts.getRawParameterValue("interval");
+    parameters.predelay = apvts.getRawParameterValue("predelay");
+    parameters.mix = apvts.getRawParameterValue("mix");
+    parameters.modulation = apvts.getRawParameterValue("modulation");
+    parameters.quality = apvts.getRawParameterValue("quality");
+    parameters.lowCut = apvts.getRawParameterValue("lowcut");
+    parameters.highCut = apvts.getRawParameterValue("highcut");
+    parameters.freeze = apvts.getRawParameterValue("freeze");
+    parameters.threading = apvts.getRawParameterValue("threading");
+
+    for (size_t i = 0; i < learnableParameters.size(); ++i)
+        learnableParameters[i] = apvts.getParameter(learnableParameterIDs[i]);
+
+    for (auto& target : controllerTargets)
+        target.store(-1);
+
+    for (auto& value : midiValues)
+        value.store(-1.0f);
+
+    constexpr auto hallScale = ReverbTypeTraits<ReverbType::Hall>::lineScale;
+    constexpr auto shimmerScale = ReverbTypeTraits<ReverbType::Shimmer>::lineScale;
+    floatPath.hallTank.setRoomScale((float) hallScale);
+    floatPath.shimmerTank.setRoomScale((float) shimmerScale);
+    doublePath.hallTank.setRoomScale(hallScale);
+    doublePath.shimmerTank.setRoomScale(shimmerScale);
+
+    apvts.addParameterListener("quality", this);
+    convolutionReverb.addChangeListener(this);
 }
 
 IKReverbAudioProcessor::~IKReverbAudioProcessor()
 {
+    stopTimer();
+    convolutionReverb.removeChangeListener(this);
+    apvts.removeParameterListener("quality", this);
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -120,7 +189,43 @@ bool IKReverbAudioProcessor::isMidiEffect() const
 
 double IKReverbAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    auto snapshot = getParameterSnapshot();
+    auto type = static_cast<ReverbType>(snapshot.type);
+    auto size = snapshot.size;
+    auto preDelaySeconds = snapshot.predelayMs * 0.001;
+    auto latencySeconds = getLatencySamples() / currentSampleRate;
+
+    return dispatchReverbType(type, [&](auto traits)
+    {
+        using Traits = decltype(traits);
+        double rt60 = 0.0;
+        double earlySeconds = 0.0;
+
+        if constexpr (Traits::engine == TankEngine::convolution)
+        {
+            // The IR is already trimmed at -90 dB
+            return convolutionReverb.getImpulseResponseSeconds() + preDelaySeconds + latencySeconds;
+        }
+        else if constexpr (Traits::engine == TankEngine::freeverb)
+        {
+            // juce::dsp::Reverb: comb feedback is roomSize * 0.28 + 0.7, and
+            // the longest comb (with the stereo spread) is 1640 samples at 44.1 kHz
+            const auto feedback = size * Traits::roomSizeScale * 0.28 + 0.7;
+            rt60 = 3.0 * (1640.0 / 44100.0) / -std::log10(feedback);
+
+            // The tank is fed through the reflections
+            if constexpr (Traits::hasEarlyReflections)
+                earlySeconds = EarlyReflections<float>::maxDelaySeconds;
+        }
+        else
+        {
+            rt60 = Traits::getDecaySeconds(size);
+        }
+
+        // Down 90 dB, i.e. 1.5 x RT60. Damping only darkens the tail: the loop
+        // filters pass DC, so the lows still ring for the full time
+        return 1.5 * rt60 + earlySeconds + preDelaySeconds + latencySeconds;
+    });
 }
 
 int IKReverbAudioProcessor::getNumPrograms()
@@ -147,43 +252,375 @@ void IKReverbAudioProcessor::changeProgramName (int index, const juce::String& n
 {
 }
 
+IKReverbAudioProcessor::ParameterSnapshot IKReverbAudioProcessor::getParameterSnapshot() const noexcept
+{
+    ParameterSnapshot snapshot;
+    snapshot.size = parameters.size->load(std::memory_order_relaxed);
+    snapshot.damping = parameters.damping->load(std::memory_order_relaxed);
+    snapshot.predelayMs = parameters.predelay->load(std::memory_order_relaxed);
+    snapshot.mix = parameters.mix->load(std::memory_order_relaxed);
+    snapshot.modulation = parameters.modulation->load(std::memory_order_relaxed);
+    snapshot.lowCut = parameters.lowCut->load(std::memory_order_relaxed);
+    snapshot.highCut = parameters.highCut->load(std::memory_order_relaxed);
+    snapshot.type = juce::jlimit(0, (int) ReverbType::NumTypes - 1, static_cast<int>(parameters.type->load(std::memory_order_relaxed)));
+    snapshot.interval = juce::jlimit(0, (int) std::size(shimmerRatios) - 1, static_cast<int>(parameters.interval->load(std::memory_order_relaxed)));
+    snapshot.eco = parameters.quality->load(std::memory_order_relaxed) > 0.5f;
+    snapshot.multiThreaded = parameters.threading->load(std::memory_order_relaxed) > 0.5f;
+    snapshot.freeze = parameters.freeze->load(std::memory_order_relaxed) > 0.5f;
+
+    // Learned controller moves the host hasn't been told about yet
+    auto learned = [this](LearnableIndex index, float value)
+    {
+        const auto normalised = midiValues[(size_t) index].load(std::memory_order_relaxed);
+        return normalised < 0.0f ? value : learnableParameters[(size_t) index]->convertFrom0to1(normalised);
+    };
+
+    snapshot.size = learned(learnSize, snapshot.size);
+    snapshot.mix = learned(learnMix, snapshot.mix);
+    snapshot.predelayMs = learned(learnPredelay, snapshot.predelayMs);
+    snapshot.freeze = learned(learnFreeze, snapshot.freeze ? 1.0f : 0.0f) > 0.5f;
+    return snapshot;
+}
+
 //==============================================================================
 void IKReverbAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    auto snapshot = getParameterSnapshot();
+
     currentSampleRate = sampleRate;
+    ecoFactor = getEcoFactor(sampleRate, snapshot.eco);
+    internalSampleRate = sampleRate / ecoFactor;
+
+    // Surround beds share one stereo send into the tanks; the tanks (or the
+    // spreader behind the stereo-only ones) fill in the other channels
+    auto numChannels = getTotalNumOutputChannels();
+    numSendChannels = juce::jmin(2, numChannels);
+
+    // Everything on the wet path runs at the internal rate
     juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getTotalNumOutputChannels();
-    
-    reverb.prepare(spec);
-    preDelay.prepare(spec);
-    
-    // Initialize filters
-    lowCutFilter.prepare(spec);
-    highCutFilter.prepare(spec);
-    
-    // Initialize filter coefficients
-    auto lowCutFreq = apvts.getRawParameterValue("lowcut")->load();
-    auto highCutFreq = apvts.getRawParameterValue("highcut")->load();
+    spec.sampleRate = internalSampleRate;
+    spec.maximumBlockSize = (juce::uint32) (juce::jmax(1, samplesPerBlock) / ecoFactor + 2);
+    spec.numChannels = (juce::uint32) numChannels;
+
+    auto sendSpec = spec;
+    sendSpec.numChannels = (juce::uint32) numSendChannels;
     
-    *lowCutFilter.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, lowCutFreq);
-    *highCutFilter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, highCutFreq);
+    reverb.prepare(sendSpec);
+    convolutionReverb.prepare(sendSpec);
+    lastType = -1;
+
+    // Start every ramp at the current value
+    auto resetRamp = [sampleRate](juce::SmoothedValue<float>& ramp, float value)
+    {
+        ramp.reset(sampleRate, smoothingSeconds);
+        ramp.setCurrentAndTargetValue(value);
+    };
+
+    resetRamp(sizeSmoothed, snapshot.size);
+    resetRamp(dampingSmoothed, snapshot.damping);
+    resetRamp(modulationSmoothed, snapshot.modulation);
+    resetRamp(mixSmoothed, snapshot.mix);
+
+    // One channel group per thread that can help
+    numChannelGroups = juce::jlimit(1, maxChannelGroups, juce::jmin(numChannels, workerPool->getNumWorkers() + 1));
+
+    // Only the path for the host's precision is prepared. The other one is
+    // marked unprepared, so a processBlock at the wrong precision is silent
+    // rather than running on stale buffers
+    if (isUsingDoublePrecision())
+    {
+        floatPath.wetBuffer.setSize(0, 0);
+        prepareWetPath(doublePath, spec, samplesPerBlock);
+    }
+    else
+    {
+        doublePath.wetBuffer.setSize(0, 0);
+        prepareWetPath(floatPath, spec, samplesPerBlock);
+    }
+
+    wetPathAsleep = false;
+    silentInputSamples = 0;
+    quietWetSamples = 0;
+    sleepHoldSamples = juce::roundToInt(sleepHoldSeconds * sampleRate);
     
-    // Initialize reverb parameters
+    // Initialize reverb parameters; every tank outputs pure wet and the
+    // dry/wet balance is applied once at the end of processBlock
     reverbParams.roomSize = 0.5f;
     reverbParams.damping = 0.5f;
-    reverbParams.wetLevel = 0.33f;
-    reverbParams.dryLevel = 0.67f;
+    reverbParams.wetLevel = 1.0f;
+    reverbParams.dryLevel = 0.0f;
     reverbParams.width = 1.0f;
     reverbParams.freezeMode = 0.0f;
     reverb.setParameters(reverbParams);
 }
 
+template <typename SampleType>
+void IKReverbAudioProcessor::prepareWetPath (WetPath<SampleType>& path, const juce::dsp::ProcessSpec& spec, int samplesPerBlock)
+{
+    auto snapshot = getParameterSnapshot();
+    auto numChannels = (int) spec.numChannels;
+    auto layout = getChannelLayoutOfBus(false, 0);
+
+    auto sendSpec = spec;
+    sendSpec.numChannels = (juce::uint32) numSendChannels;
+
+    path.surroundSend.prepare(layout);
+    lfeChannel = numChannels > 2 ? path.surroundSend.getLfeChannel() : -1;
+
+    path.hallTank.prepare(spec);
+    path.shimmerTank.prepare(spec);
+    path.springTank.prepare(sendSpec);
+    path.plateTank.prepare(sendSpec);
+    path.surroundSpreader.prepare(spec, layout);
+    path.freezeLooper.prepare(spec);
+    path.preDelay.prepare(sendSpec, maxPreDelaySeconds);
+    path.preDelay.setDelay(static_cast<SampleType>(snapshot.predelayMs * 0.001 * internalSampleRate));
+    path.preDelay.reset();
+    path.wetChorus.prepare(sendSpec);
+    path.earlyReflections.prepare(sendSpec);
+    path.earlyBuffer.setSize(numSendChannels, (int) spec.maximumBlockSize);
+
+    // Initialize filters, starting at the current cutoffs without a glide
+    path.cutFilter.prepare(sendSpec);
+    path.cutFilter.setCutoffFrequencies(snapshot.lowCut, snapshot.highCut);
+    path.cutFilter.reset();
+
+    // Allocate the wet path once; processBlock works through it in chunks
+    // if a host ever sends more than samplesPerBlock
+    path.wetBuffer.setSize(numChannels, juce::jmax(1, samplesPerBlock));
+    path.wetBuffer.clear();
+
+    if constexpr (! std::is_same_v<SampleType, float>)
+        path.floatSend.setSize(numSendChannels, (int) spec.maximumBlockSize);
+
+    path.dryGains.assign((size_t) juce::jmax(1, samplesPerBlock), SampleType(1));
+    path.wetGains.assign((size_t) juce::jmax(1, samplesPerBlock), SampleType(0));
+
+    // The resampler's latency is reported to the host, and the dry signal
+    // is delayed by the same amount so the two stay aligned
+    path.ecoResampler.prepare(numChannels, ecoFactor, juce::jmax(1, samplesPerBlock));
+    auto latency = path.ecoResampler.getLatencySamples();
+    auto sampleRate = currentSampleRate;
+
+    // Each channel group has its own interpolator and dry delay
+    for (int g = 0; g < numChannelGroups; ++g)
+    {
+        auto& group = path.channelGroups[(size_t) g];
+        group.firstChannel = numChannels * g / numChannelGroups;
+        group.numChannels = numChannels * (g + 1) / numChannelGroups - group.firstChannel;
+
+        group.upsampler.prepare(group.numChannels, ecoFactor, juce::jmax(1, samplesPerBlock));
+        group.dryDelay.prepare({ sampleRate, (juce::uint32) juce::jmax(1, samplesPerBlock), (juce::uint32) group.numChannels },
+                               latency / sampleRate);
+        group.dryDelay.setDelay((SampleType) latency);
+        group.dryDelay.reset();
+    }
+
+    setLatencySamples(latency);
+    telemetry.prepare(sampleRate);
+}
+
 void IKReverbAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    floatPath.wetBuffer.setSize(0, 0);
+    doublePath.wetBuffer.setSize(0, 0);
+}
+
+bool IKReverbAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+void IKReverbAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+
+    // Offline, the convolution tail must never be late, however fast we run
+    convolutionReverb.setNonRealtime(isNonRealtime);
+}
+
+void IKReverbAudioProcessor::reset()
+{
+    // Drops every tail and jumps straight to the current settings, so the
+    // next block starts as if the plugin had just been prepared
+    auto snapshot = getParameterSnapshot();
+
+    auto resetPath = [this, &snapshot](auto& path)
+    {
+        using SampleType = typename std::decay_t<decltype(path.dryGains)>::value_type;
+
+        path.preDelay.setDelay(static_cast<SampleType>(snapshot.predelayMs * 0.001 * internalSampleRate));
+        path.cutFilter.setCutoffFrequencies(snapshot.lowCut, snapshot.highCut);
+        resetWetPath(path);
+
+        for (int g = 0; g < numChannelGroups; ++g)
+            path.channelGroups[(size_t) g].dryDelay.reset();
+    };
+
+    if (isUsingDoublePrecision())
+        resetPath(doublePath);
+    else
+        resetPath(floatPath);
+
+    lastType = -1;
+
+    sizeSmoothed.setCurrentAndTargetValue(snapshot.size);
+    dampingSmoothed.setCurrentAndTargetValue(snapshot.damping);
+    modulationSmoothed.setCurrentAndTargetValue(snapshot.modulation);
+    mixSmoothed.setCurrentAndTargetValue(snapshot.mix);
+
+    wetPathAsleep = false;
+    silentInputSamples = 0;
+    quietWetSamples = 0;
+}
+
+TankEngine IKReverbAudioProcessor::getTankEngine (ReverbType type)
+{
+    return dispatchReverbType(type, [](auto traits) { return decltype(traits)::engine; });
+}
+
+template <typename SampleType>
+void IKReverbAudioProcessor::resetTank (WetPath<SampleType>& path, TankEngine engine) noexcept
+{
+    switch (engine)
+    {
+        case TankEngine::fdn16:     path.hallTank.reset(); break;
+        case TankEngine::fdn8:      path.shimmerTank.reset(); break;
+        case TankEngine::spring:    path.springTank.reset(); path.surroundSpreader.reset(); break;
+        case TankEngine::plate:     path.plateTank.reset(); path.surroundSpreader.reset(); break;
+        case TankEngine::convolution: convolutionReverb.reset(); path.surroundSpreader.reset(); break;
+        case TankEngine::freeverb:
+        default:                    reverb.reset(); path.surroundSpreader.reset(); path.earlyReflections.reset(); break;
+    }
+}
+
+template <typename SampleType>
+void IKReverbAudioProcessor::resetWetPath (WetPath<SampleType>& path) noexcept
+{
+    // Everything here is below the silence threshold; clearing it means the
+    // next note starts from true silence rather than from denormal residue
+    resetTank(path, getTankEngine(static_cast<ReverbType>(juce::jmax(0, lastType))));
+    path.cutFilter.reset();
+    path.preDelay.reset();
+    path.wetChorus.reset();
+    path.freezeLooper.reset();
+    path.ecoResampler.reset();
+
+    // The dry delays carry the dry signal, so they keep running through
+    // sleep; only reset() clears them
+    for (int g = 0; g < numChannelGroups; ++g)
+        path.channelGroups[(size_t) g].upsampler.reset();
+}
+
+int IKReverbAudioProcessor::getEcoFactor (double sampleRate, bool eco)
+{
+    if (! eco)
+        return 1;
+
+    // Keep the internal rate at 44.1/48 kHz or above
+    if (sampleRate >= 160000.0)
+        return 4;
+
+    if (sampleRate >= 80000.0)
+        return 2;
+
+    return 1;
+}
+
+void IKReverbAudioProcessor::runJobs (WorkerPool::Job job, int numJobs, bool parallel) noexcept
+{
+    if (parallel)
+    {
+        workerPool->run(job, this, numJobs);
+        return;
+    }
+
+    for (int i = 0; i < numJobs; ++i)
+        job(this, i);
+}
+
+template <typename SampleType>
+void IKReverbAudioProcessor::convolveChannel (void* context, int index) noexcept
+{
+    auto& processor = *static_cast<IKReverbAudioProcessor*>(context);
+    processor.convolutionReverb.processChannel(processor.getWetPath<SampleType>().chunk.floatSend, (size_t) index);
+}
+
+template <typename SampleType, TankEngine engine>
+void IKReverbAudioProcessor::finishChannelGroup (void* context, int index) noexcept
+{
+    auto& processor = *static_cast<IKReverbAudioProcessor*>(context);
+    auto& path = processor.getWetPath<SampleType>();
+    auto& group = path.channelGroups[(size_t) index];
+    auto& chunk = path.chunk;
+
+    const auto firstChannel = (size_t) group.firstChannel;
+    const auto numChannels = (size_t) juce::jmin(group.numChannels, (int) chunk.wetBlock.getNumChannels() - group.firstChannel);
+
+    if (group.firstChannel >= (int) chunk.wetBlock.getNumChannels() || numChannels == 0)
+        return;
+
+    // The FDNs left their line taps behind for the surround channels
+    if constexpr (engine == TankEngine::fdn16 || engine == TankEngine::fdn8)
+        if (chunk.tankRunning)
+            getFDNTank<engine>(path).renderExtraOutputs(chunk.tankBlock, group.firstChannel, (int) numChannels);
+
+    path.freezeLooper.process(chunk.tankBlock, group.firstChannel, (int) numChannels);
+
+    if (processor.ecoFactor > 1)
+    {
+        auto wet = chunk.wetBlock.getSubsetChannelBlock(firstChannel, numChannels);
+        group.upsampler.processUp(chunk.tankBlock.getSubsetChannelBlock(firstChannel, numChannels), wet);
+
+        auto dry = chunk.dryBlock.getSubsetChannelBlock(firstChannel, numChannels);
+        group.dryDelay.process(juce::dsp::ProcessContextReplacing<SampleType>(dry));
+    }
+
+    // Mix dry and wet signals; the LFE stays dry
+    const auto numSamples = (int) chunk.wetBlock.getNumSamples();
+
+    for (auto channel = firstChannel; channel < firstChannel + numChannels; ++channel)
+    {
+        if ((int) channel == processor.lfeChannel)
+            continue;
+
+        auto* dryData = chunk.dryBlock.getChannelPointer(channel);
+        auto* wetData = chunk.wetBlock.getChannelPointer(channel);
+
+        if (chunk.dryGains != nullptr)
+        {
+            juce::FloatVectorOperations::multiply(dryData, chunk.dryGains, numSamples);
+            juce::FloatVectorOperations::addWithMultiply(dryData, wetData, chunk.wetGains, numSamples);
+        }
+        else
+        {
+            juce::FloatVectorOperations::multiply(dryData, chunk.dryMix, numSamples);
+            juce::FloatVectorOperations::addWithMultiply(dryData, wetData, chunk.wetMix, numSamples);
+        }
+    }
+}
+
+void IKReverbAudioProcessor::parameterChanged (const juce::String& parameterID, float)
+{
+    if (parameterID == "quality")
+        triggerAsyncUpdate();
+}
+
+void IKReverbAudioProcessor::handleAsyncUpdate()
+{
+    // Tell the host about the new latency; it re-prepares the plugin, which
+    // is where the wet path actually switches rate
+    HalfBandResampler<float> probe;
+    probe.prepare(1, getEcoFactor(currentSampleRate, parameters.quality->load() > 0.5f), 1);
+    setLatencySamples(probe.getLatencySamples());
+}
+
+void IKReverbAudioProcessor::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    // The convolution loader has read a new IR, so its name has changed
+    sendChangeMessage();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -193,12 +630,8 @@ bool IKReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Mono, stereo and the standard surround beds up to 7.1.4
+    if (! SurroundLayout::isSupported(layouts.getMainOutputChannelSet()))
         return false;
 
     // This checks if the input layout matches the output layout
@@ -214,152 +647,497 @@ bool IKReverbAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 
 void IKReverbAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                                juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages);
+}
+
+void IKReverbAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer,
+                                               juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages);
+}
+
+template <typename SampleType>
+void IKReverbAudioProcessor::process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    RealtimeSafetyChecker::ScopedAudioThread realtimeCheck;
+
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
+    auto numSamples = buffer.getNumSamples();
 
-    // Update reverb parameters
-    auto* sizeParam = apvts.getRawParameterValue("size");
-    auto* dampingParam = apvts.getRawParameterValue("damping");
-    auto* mixParam = apvts.getRawParameterValue("mix");
-    auto* typeParam = apvts.getRawParameterValue("type");
-    auto* predelayParam = apvts.getRawParameterValue("predelay");
-    auto* modulationParam = apvts.getRawParameterValue("modulation");
-    auto* lowCutParam = apvts.getRawParameterValue("lowcut");
-    auto* highCutParam = apvts.getRawParameterValue("highcut");
-
-    // Update filter coefficients
-    *lowCutFilter.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(currentSampleRate, lowCutParam->load());
-    *highCutFilter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(currentSampleRate, highCutParam->load());
-
-    // Create audio block for filter processing
-    juce::dsp::AudioBlock<float> filterBlock(buffer);
-    juce::dsp::ProcessContextReplacing<float> filterContext(filterBlock);
-    
-    // Apply filters
-    lowCutFilter.process(filterContext);
-    highCutFilter.process(filterContext);
-
-    // Update reverb parameters based on type
-    float baseSize = sizeParam->load();
-    float baseDamping = dampingParam->load();
-    float modulation = modulationParam->load();
-    
-    switch (static_cast<int>(typeParam->load()))
-    {
-        case 0: // Room
-            reverbParams.roomSize = baseSize * 0.4f;
-            reverbParams.damping = baseDamping * 0.9f;
-            reverbParams.width = 0.5f;
-            break;
-            
-        case 1: // Hall
-            reverbParams.roomSize = baseSize * 1.0f;
-            reverbParams.damping = baseDamping * 0.2f;
-            reverbParams.width = 1.0f;
-            break;
-            
-        case 2: // Plate
-            reverbParams.roomSize = baseSize * 0.6f;
-            reverbParams.damping = baseDamping * 0.1f;
-            reverbParams.width = 0.75f;
-            break;
-            
-        case 3: // Spring
-            reverbParams.roomSize = baseSize * 0.3f;
-            reverbParams.damping = baseDamping * 0.4f;
-            reverbParams.width = 0.3f;
-            break;
-            
-        case 4: // Shimmer
-            reverbParams.roomSize = baseSize * 0.8f;
-            reverbParams.damping = baseDamping * 0.3f;
-            reverbParams.width = 1.0f;
-            break;
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear(i, 0, numSamples);
+
+    // Not prepared yet, or not at this precision
+    if (getWetPath<SampleType>().wetBuffer.getNumSamples() == 0)
+        return;
+
+    if (telemetry.beginBlock())
+        telemetry.addLevels(Telemetry::input, buffer, 0, numSamples, totalNumInputChannels);
+
+    // MULTI decides on the host block, so its remainder and the pieces
+    // between MIDI events go to the pool along with the full sub-blocks
+    parallelHostBlock = numSamples >= minParallelSamples;
+
+    // Split at every MIDI event, so a learned CC lands on its exact sample,
+    // and into sub-blocks short enough that the per-block tank controls
+    // follow their ramps without audible steps on long render blocks
+    int renderedSamples = 0;
+
+    auto renderUpTo = [&](int endSample)
+    {
+        while (renderedSamples < endSample)
+        {
+            auto length = juce::jmin(maxSubBlockSize, endSample - renderedSamples);
+            juce::AudioBuffer<SampleType> subBlock(buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                                   renderedSamples, length);
+            processSubBlock(subBlock);
+            renderedSamples += length;
+        }
+    };
+
+    for (const auto metadata : midiMessages)
+    {
+        renderUpTo(juce::jlimit(0, numSamples, metadata.samplePosition));
+        handleMidiMessage(metadata.getMessage());
     }
-    
-    reverbParams.wetLevel = mixParam->load();
-    reverbParams.dryLevel = 1.0f - mixParam->load();
-    reverbParams.freezeMode = 0.0f;
-    reverb.setParameters(reverbParams);
 
-    // Pre-delay time in samples
-    int predelayTimeSamples = static_cast<int>((predelayParam->load() / 1000.0f) * currentSampleRate);
-    preDelay.setDelay(predelayTimeSamples);
-    
-    // Create temporary buffers for processing
-    juce::AudioBuffer<float> wetBuffer(totalNumInputChannels, buffer.getNumSamples());
-    wetBuffer.clear();
+    renderUpTo(numSamples);
+
+    telemetry.addLevels(Telemetry::output, buffer, 0, numSamples, totalNumOutputChannels);
+    telemetry.endBlock(numSamples);
+}
 
-    // Copy input to wet buffer
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+void IKReverbAudioProcessor::handleMidiMessage (const juce::MidiMessage& message) noexcept
+{
+    if (! message.isController())
+        return;
+
+    const auto controller = message.getControllerNumber();
+
+    // A pending learn takes the first controller that moves
+    const auto learnTarget = midiLearnTarget.exchange(-1);
+
+    if (learnTarget >= 0)
     {
-        wetBuffer.copyFrom(channel, 0, buffer, channel, 0, buffer.getNumSamples());
+        for (auto& target : controllerTargets)
+            if (target.load() == learnTarget)
+                target.store(-1);
+
+        controllerTargets[(size_t) controller].store(learnTarget);
     }
 
-    // Apply pre-delay if needed
-    if (predelayTimeSamples > 0)
+    const auto target = controllerTargets[(size_t) controller].load();
+
+    if (target < 0)
+        return;
+
+    // Freeze is a switch; the others follow the controller's full range.
+    // Setting the parameter would lock and call listeners, so the value
+    // waits here for the next sub-block's snapshot and the timer
+    const auto value = message.getControllerValue();
+
+    if (target == learnFreeze)
+        midiValues[(size_t) target].store(value >= 64 ? 1.0f : 0.0f);
+    else
+        midiValues[(size_t) target].store((float) value / 127.0f);
+}
+
+void IKReverbAudioProcessor::timerCallback()
+{
+    for (size_t i = 0; i < midiValues.size(); ++i)
+    {
+        auto value = midiValues[i].load();
+
+        if (value < 0.0f)
+            continue;
+
+        auto* parameter = learnableParameters[i];
+        parameter->beginChangeGesture();
+        parameter->setValueNotifyingHost(value);
+        parameter->endChangeGesture();
+
+        // A newer move that came in meanwhile stays for the next tick
+        midiValues[i].compare_exchange_strong(value, -1.0f);
+    }
+
+    // The audio thread completes a learn; tell the listeners here
+    if (midiLearnTarget.load() != notifiedLearnTarget)
+        midiControlChanged();
+
+    // Stopping here rather than in clearMidiMapping() lets a move the audio
+    // thread was storing as the mapping went still reach the host
+    if (! hasMidiControl()
+         && std::all_of(midiValues.begin(), midiValues.end(), [](auto& value) { return value.load() < 0.0f; }))
+        stopTimer();
+}
+
+bool IKReverbAudioProcessor::hasMidiControl() const noexcept
+{
+    if (midiLearnTarget.load() >= 0)
+        return true;
+
+    for (auto& target : controllerTargets)
+        if (target.load() >= 0)
+            return true;
+
+    return false;
+}
+
+void IKReverbAudioProcessor::midiControlChanged()
+{
+    // Runs only while a controller can reach a parameter; timerCallback()
+    // stops it again
+    if (hasMidiControl())
+        startTimer(midiPushIntervalMs);
+
+    notifiedLearnTarget = midiLearnTarget.load();
+    sendChangeMessage();
+}
+
+template <typename SampleType>
+void IKReverbAudioProcessor::processSubBlock (juce::AudioBuffer<SampleType>& buffer)
+{
+    // One coherent set of values for the sub-block
+    const auto snapshot = getParameterSnapshot();
+
+    dispatchReverbType(static_cast<ReverbType>(snapshot.type), [&](auto traits)
     {
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        processSubBlock<SampleType, decltype(traits)>(buffer, snapshot);
+    });
+}
+
+template <typename SampleType, typename Traits>
+void IKReverbAudioProcessor::processSubBlock (juce::AudioBuffer<SampleType>& buffer, const ParameterSnapshot& snapshot)
+{
+    constexpr auto engine = Traits::engine;
+    constexpr auto isFDN = engine == TankEngine::fdn16 || engine == TankEngine::fdn8;
+
+    auto& path = getWetPath<SampleType>();
+    auto& chunk = path.chunk;
+    auto totalNumInputChannels = getTotalNumInputChannels();
+    auto numSamples = buffer.getNumSamples();
+
+    // Filter coefficients are only recomputed while a cutoff is moving
+    path.cutFilter.setCutoffFrequencies(snapshot.lowCut, snapshot.highCut);
+
+    // The tank controls move to the end of this block's stretch of their ramps
+    sizeSmoothed.setTargetValue(snapshot.size);
+    dampingSmoothed.setTargetValue(snapshot.damping);
+    modulationSmoothed.setTargetValue(snapshot.modulation);
+    mixSmoothed.setTargetValue(snapshot.mix);
+
+    // The type's constants map the controls onto its tank
+    float baseSize = sizeSmoothed.skip(numSamples);
+    float baseDamping = dampingSmoothed.skip(numSamples);
+    float modulation = modulationSmoothed.skip(numSamples);
+    float modRate = 0.4f + modulation * 1.6f;     // Deeper modulation also moves faster
+
+    if constexpr (Traits::hasChorus)
+    {
+        if (modulation > 0.0f && lastModulation <= 0.0f)
+            path.wetChorus.reset();
+
+        path.wetChorus.setParameters(modulation, modRate);
+    }
+
+    lastModulation = modulation;
+
+    if constexpr (isFDN)
+    {
+        auto& tank = getFDNTank<engine>(path);
+        typename std::decay_t<decltype(tank)>::Parameters tankParams;
+        tankParams.decaySeconds = Traits::getDecaySeconds(baseSize);
+        tankParams.damping = baseDamping * Traits::dampingScale;
+        tankParams.width = Traits::width;
+        tankParams.modDepth = modulation;
+        tankParams.modRate = modRate;
+
+        if constexpr (Traits::shimmer > 0.0f)
         {
-            auto* channelData = wetBuffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-            {
-                channelData[sample] = preDelay.popSample(channel, channelData[sample]);
-            }
+            tankParams.shimmer = Traits::shimmer;
+            tankParams.shimmerRatio = shimmerRatios[snapshot.interval];
         }
+
+        tank.setParameters(tankParams);
+    }
+    else if constexpr (engine == TankEngine::spring)
+    {
+        typename SpringReverb<SampleType>::Parameters springParams;
+        springParams.decaySeconds = Traits::getDecaySeconds(baseSize);
+        springParams.damping = baseDamping * Traits::dampingScale;
+        springParams.length = baseSize;
+        springParams.drip = Traits::minDrip + (1.0f - Traits::minDrip) * modulation;
+        springParams.dripRate = modRate;
+        path.springTank.setParameters(springParams);
+    }
+    else if constexpr (engine == TankEngine::plate)
+    {
+        typename PlateReverb<SampleType>::Parameters plateParams;
+        plateParams.decaySeconds = Traits::getDecaySeconds(baseSize);
+        plateParams.damping = baseDamping * Traits::dampingScale;
+        plateParams.width = Traits::width;
+        plateParams.modDepth = Traits::minModulation + (1.0f - Traits::minModulation) * modulation;
+        plateParams.modRate = modRate;
+        path.plateTank.setParameters(plateParams);
+    }
+    else if constexpr (engine == TankEngine::freeverb)
+    {
+        reverbParams.roomSize = baseSize * Traits::roomSizeScale;
+        reverbParams.damping = baseDamping * Traits::dampingScale;
+        reverbParams.width = Traits::width;
+        reverbParams.wetLevel = 1.0f;
+        reverbParams.dryLevel = 0.0f;
+        reverbParams.freezeMode = 0.0f;     // Freeze is the loop buffer, for every type
+        reverb.setParameters(reverbParams);
     }
 
-    // Process reverb
-    juce::dsp::AudioBlock<float> reverbBlock(wetBuffer);
-    juce::dsp::ProcessContextReplacing<float> reverbContext(reverbBlock);
-    reverb.process(reverbContext);
+    if constexpr (Traits::hasEarlyReflections)
+        path.earlyReflections.setGeometry(Traits::getGeometry(baseSize, baseDamping));
 
-    // Apply modulation
-    if (modulation > 0.0f)
+    // Start a newly selected tank from silence rather than from a stale tail
+    if (snapshot.type != lastType)
     {
-        float modDepth = modulation * 0.002f; // Subtle modulation
-        float modSpeed = 3.0f; // 3 Hz modulation rate
+        resetTank(path, engine);
+        lastType = snapshot.type;
+    }
+
+    path.freezeLooper.setFrozen(snapshot.freeze);
 
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    // Pre-delay time in samples; the stage glides to it
+    path.preDelay.setDelay(static_cast<SampleType>(snapshot.predelayMs * 0.001 * internalSampleRate));
+
+    const auto parallel = snapshot.multiThreaded && parallelHostBlock;
+
+    auto& wetBuffer = path.wetBuffer;
+    auto numWetChannels = juce::jmin(totalNumInputChannels, wetBuffer.getNumChannels());
+
+    // Any input above the threshold wakes the wet path for this very block
+    if (buffer.getMagnitude(0, numSamples) > (SampleType) silenceThreshold)
+    {
+        silentInputSamples = 0;
+        quietWetSamples = 0;
+        wetPathAsleep = false;
+    }
+    else
+    {
+        silentInputSamples = juce::jmin(silentInputSamples, std::numeric_limits<int>::max() - numSamples) + numSamples;
+    }
+
+    // Asleep: the wet output is zero, so only the dry gain is left to apply,
+    // after the same compensation delay as when awake so the dry latency
+    // doesn't jump as the wet path sleeps and wakes
+    if (wetPathAsleep)
+    {
+        if (ecoFactor > 1)
         {
-            auto* channelData = wetBuffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+            juce::dsp::AudioBlock<SampleType> block(buffer);
+
+            for (int startSample = 0; startSample < numSamples; startSample += wetBuffer.getNumSamples())
             {
-                float modPhase = std::sin(2.0f * juce::MathConstants<float>::pi * shimmerPhase);
-                channelData[sample] *= (1.0f + modPhase * modDepth);
-                shimmerPhase += modSpeed / currentSampleRate;
-                if (shimmerPhase >= 1.0f)
-                    shimmerPhase -= 1.0f;
+                const auto chunkSize = juce::jmin(wetBuffer.getNumSamples(), numSamples - startSample);
+
+                for (int g = 0; g < numChannelGroups; ++g)
+                {
+                    auto& group = path.channelGroups[(size_t) g];
+                    const auto groupChannels = juce::jmin(group.numChannels, numWetChannels - group.firstChannel);
+
+                    if (groupChannels <= 0)
+                        continue;
+
+                    auto dry = block.getSubBlock((size_t) startSample, (size_t) chunkSize)
+                                    .getSubsetChannelBlock((size_t) group.firstChannel, (size_t) groupChannels);
+                    group.dryDelay.process(juce::dsp::ProcessContextReplacing<SampleType>(dry));
+                }
             }
         }
+
+        const auto startDry = 1.0f - mixSmoothed.getCurrentValue();
+        const auto endDry = 1.0f - mixSmoothed.skip(numSamples);
+
+        for (int channel = 0; channel < numWetChannels; ++channel)
+            if (channel != lfeChannel)
+                buffer.applyGainRamp(channel, 0, numSamples, startDry, endDry);
+
+        return;
     }
 
-    // Mix dry and wet signals
-    float wetMix = mixParam->load();
-    float dryMix = 1.0f - wetMix;
+    auto maxChunkSize = wetBuffer.getNumSamples();
 
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    // The wet path runs through the preallocated wetBuffer, one chunk of at
+    // most the prepared block size at a time
+    for (int startSample = 0; startSample < numSamples; startSample += maxChunkSize)
     {
-        auto* dryData = buffer.getWritePointer(channel);
-        auto* wetData = wetBuffer.getWritePointer(channel);
+        auto chunkSize = juce::jmin(maxChunkSize, numSamples - startSample);
+
+        // Per-sample mix gains while the mix ramps
+        if (mixSmoothed.isSmoothing())
+        {
+            for (int i = 0; i < chunkSize; ++i)
+            {
+                path.wetGains[(size_t) i] = (SampleType) mixSmoothed.getNextValue();
+                path.dryGains[(size_t) i] = SampleType(1) - path.wetGains[(size_t) i];
+            }
+
+            chunk.dryGains = path.dryGains.data();
+            chunk.wetGains = path.wetGains.data();
+        }
+        else
+        {
+            chunk.wetMix = (SampleType) mixSmoothed.getTargetValue();
+            chunk.dryMix = SampleType(1) - chunk.wetMix;
+            chunk.dryGains = chunk.wetGains = nullptr;
+        }
+
+        auto wetBlock = juce::dsp::AudioBlock<SampleType>(wetBuffer)
+                            .getSubsetChannelBlock(0, (size_t) numWetChannels)
+                            .getSubBlock(0, (size_t) chunkSize);
+        auto sendBlock = wetBlock.getSubsetChannelBlock(0, (size_t) numSendChannels);
 
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+        // Copy input to the send, folding surround beds down to stereo
+        if (numWetChannels > 2)
         {
-            dryData[sample] = dryData[sample] * dryMix + wetData[sample] * wetMix;
+            path.surroundSend.process(juce::dsp::AudioBlock<const SampleType>(buffer)
+                                     .getSubsetChannelBlock(0, (size_t) numWetChannels)
+                                     .getSubBlock((size_t) startSample, (size_t) chunkSize),
+                                 sendBlock);
         }
+        else
+        {
+            for (int channel = 0; channel < numSendChannels; ++channel)
+                wetBuffer.copyFrom(channel, 0, buffer, channel, startSample, chunkSize);
+        }
+
+        // In eco mode everything up to the mix runs on the decimated block
+        auto tankBlock = ecoFactor > 1 ? path.ecoResampler.processDown(sendBlock, (size_t) numWetChannels) : wetBlock;
+        auto tankSend = tankBlock.getSubsetChannelBlock(0, (size_t) numSendChannels);
+
+        // Apply filters
+        path.cutFilter.process(juce::dsp::ProcessContextReplacing<SampleType>(tankSend));
+
+        // Apply pre-delay
+        path.preDelay.process(juce::dsp::ProcessContextReplacing<SampleType>(tankSend));
+
+        chunk.tankRunning = path.freezeLooper.isTankRunning();
+        chunk.tankBlock = tankBlock;
+        chunk.tankSend = tankSend;
+        chunk.wetBlock = wetBlock;
+        chunk.dryBlock = juce::dsp::AudioBlock<SampleType>(buffer)
+                             .getSubsetChannelBlock(0, (size_t) numWetChannels)
+                             .getSubBlock((size_t) startSample, (size_t) chunkSize);
+
+        // Fully frozen, the loop replaces the tank's output, so it can stop
+        if (chunk.tankRunning)
+        {
+            // The reflections are the tank's input, and part of the output
+            juce::dsp::AudioBlock<SampleType> earlyBlock;
+
+            if constexpr (Traits::hasEarlyReflections)
+            {
+                earlyBlock = juce::dsp::AudioBlock<SampleType>(path.earlyBuffer).getSubBlock(0, tankSend.getNumSamples());
+                path.earlyReflections.process(tankSend, earlyBlock);
+                tankSend.copyFrom(earlyBlock);
+            }
+
+            // The FDNs read the send and write channels 0 and 1, keeping
+            // their line taps for the rest of the bed
+            if constexpr (isFDN)
+                getFDNTank<engine>(path).processTank(juce::dsp::ProcessContextReplacing<SampleType>(tankBlock));
+            else if constexpr (engine == TankEngine::spring)
+                path.springTank.process(juce::dsp::ProcessContextReplacing<SampleType>(tankSend));
+            else if constexpr (engine == TankEngine::plate)
+                path.plateTank.process(juce::dsp::ProcessContextReplacing<SampleType>(tankSend));
+            else
+                processFloatTank<engine>(path, parallel);
+
+            // Only the stages this type needs are compiled in
+            if constexpr (Traits::hasChorus)
+                if (modulation > 0.0f)
+                    path.wetChorus.process(juce::dsp::ProcessContextReplacing<SampleType>(tankSend));
+
+            if constexpr (Traits::hasEarlyReflections)
+                tankSend.addProductOf(earlyBlock, (SampleType) Traits::earlyLevel);
+
+            if constexpr (Traits::hasSpreader)
+                if (numWetChannels > 2)
+                    path.surroundSpreader.process(tankBlock);
+        }
+
+        path.freezeLooper.beginBlock((int) tankBlock.getNumSamples());
+
+        // Surround taps, freeze, eco interpolation, dry delay and mix, per group
+        runJobs(finishChannelGroup<SampleType, engine>, numChannelGroups, parallel);
+
+        // wetBuffer still holds the wet signal at the host rate
+        telemetry.addLevels(Telemetry::wet, wetBuffer, 0, chunkSize, numWetChannels);
+        telemetry.addWetStream(wetBuffer.getReadPointer(0),
+                               numWetChannels > 1 ? wetBuffer.getReadPointer(1) : nullptr,
+                               chunkSize);
+
+        // Once the input is silent, watch the wet path decay
+        if (silentInputSamples > 0)
+        {
+            SampleType wetLevel = 0;
+
+            for (int channel = 0; channel < numWetChannels; ++channel)
+                wetLevel = juce::jmax(wetLevel, wetBuffer.getRMSLevel(channel, 0, chunkSize));
+
+            quietWetSamples = wetLevel < (SampleType) silenceThreshold ? quietWetSamples + chunkSize : 0;
+        }
+    }
+
+    // Sleep once the input has been silent for longer than the pre-delay
+    // and the dry delay can hold, and the wet output has stayed below the
+    // threshold for the hold time
+    auto inputFlushSamples = juce::roundToInt(snapshot.predelayMs * 0.001 * currentSampleRate) + getLatencySamples();
+
+    if (silentInputSamples > inputFlushSamples && quietWetSamples >= sleepHoldSamples && ! path.freezeLooper.isActive())
+    {
+        resetWetPath(path);
+        wetPathAsleep = true;
     }
 }
 
-float IKReverbAudioProcessor::processShimmer(float input, float amount)
+template <TankEngine engine, typename SampleType>
+void IKReverbAudioProcessor::processFloatTank (WetPath<SampleType>& path, bool parallel) noexcept
 {
-    // Simple ring modulation for shimmer effect
-    shimmerPhase += 440.0f / currentSampleRate; // 440 Hz modulation
-    if (shimmerPhase >= 1.0f)
-        shimmerPhase -= 1.0f;
-    
-    return input * std::sin(2.0f * juce::MathConstants<float>::pi * shimmerPhase) * amount;
+    auto& chunk = path.chunk;
+    const auto numChannels = chunk.tankSend.getNumChannels();
+    const auto numSamples = chunk.tankSend.getNumSamples();
+
+    // The double path hands these tanks a float copy of the send and takes
+    // their output back; the float path runs them in place
+    if constexpr (std::is_same_v<SampleType, float>)
+    {
+        chunk.floatSend = chunk.tankSend;
+    }
+    else
+    {
+        chunk.floatSend = juce::dsp::AudioBlock<float>(path.floatSend).getSubsetChannelBlock(0, numChannels)
+                                                                      .getSubBlock(0, numSamples);
+
+        for (size_t channel = 0; channel < numChannels; ++channel)
+            std::copy_n(chunk.tankSend.getChannelPointer(channel), numSamples, chunk.floatSend.getChannelPointer(channel));
+    }
+
+    if constexpr (engine == TankEngine::convolution)
+    {
+        // Every channel has its own convolver
+        if (convolutionReverb.beginBlock())
+            runJobs(convolveChannel<SampleType>, numSendChannels, parallel);
+        else
+            chunk.floatSend.clear();
+    }
+    else
+    {
+        reverb.process(juce::dsp::ProcessContextReplacing<float>(chunk.floatSend));
+    }
+
+    if constexpr (! std::is_same_v<SampleType, float>)
+        for (size_t channel = 0; channel < numChannels; ++channel)
+            std::copy_n(chunk.floatSend.getChannelPointer(channel), numSamples, chunk.tankSend.getChannelPointer(channel));
 }
 
 //==============================================================================
@@ -377,6 +1155,13 @@ juce::AudioProcessorEditor* IKReverbAudioProcessor::createEditor()
 void IKReverbAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     auto state = apvts.copyState();
+
+    // Learned controllers, one per learnable parameter (-1 when unassigned)
+    juce::StringArray controllers;
+    for (auto* id : learnableParameterIDs)
+        controllers.add(juce::String(getMidiController(id)));
+
+    state.setProperty(midiMapProperty, controllers.joinIntoString(","), nullptr);
     std::unique_ptr<juce::XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, destData);
 }
@@ -385,8 +1170,91 @@ void IKReverbAudioProcessor::setStateInformation (const void* data, int sizeInBy
 {
     std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
     if (xmlState.get() != nullptr)
+    {
         if (xmlState->hasTagName(apvts.state.getType()))
+        {
             apvts.replaceState(juce::ValueTree::fromXml(*xmlState));
+
+            auto irPath = apvts.state.getProperty(irFileProperty).toString();
+            if (irPath.isNotEmpty())
+                convolutionReverb.loadImpulseResponse(juce::File(irPath));
+
+            auto controllers = juce::StringArray::fromTokens(apvts.state.getProperty(midiMapProperty).toString(), ",", {});
+
+            for (auto& target : controllerTargets)
+                target.store(-1);
+
+            for (int i = 0; i < juce::jmin(controllers.size(), (int) learnableParameters.size()); ++i)
+            {
+                auto controller = controllers[i].getIntValue();
+                if (controllers[i].isNotEmpty() && juce::isPositiveAndBelow(controller, (int) controllerTargets.size()))
+                    controllerTargets[(size_t) controller].store(i);
+            }
+
+            midiControlChanged();
+        }
+    }
+}
+
+int IKReverbAudioProcessor::getLearnableIndex (const juce::String& parameterID)
+{
+    for (int i = 0; i < (int) std::size(learnableParameterIDs); ++i)
+        if (parameterID == learnableParameterIDs[i])
+            return i;
+
+    return -1;
+}
+
+void IKReverbAudioProcessor::beginMidiLearn (const juce::String& parameterID)
+{
+    midiLearnTarget.store(getLearnableIndex(parameterID));
+    midiControlChanged();
+}
+
+void IKReverbAudioProcessor::cancelMidiLearn()
+{
+    midiLearnTarget.store(-1);
+    midiControlChanged();
+}
+
+void IKReverbAudioProcessor::clearMidiMapping (const juce::String& parameterID)
+{
+    const auto index = getLearnableIndex(parameterID);
+
+    if (index < 0)
+        return;
+
+    auto learning = index;
+    midiLearnTarget.compare_exchange_strong(learning, -1);
+
+    for (auto& target : controllerTargets)
+        if (target.load() == index)
+            target.store(-1);
+
+    midiControlChanged();
+}
+
+int IKReverbAudioProcessor::getMidiController (const juce::String& parameterID) const
+{
+    auto index = getLearnableIndex(parameterID);
+
+    for (int controller = 0; index >= 0 && controller < (int) controllerTargets.size(); ++controller)
+        if (controllerTargets[(size_t) controller].load() == index)
+            return controller;
+
+    return -1;
+}
+
+bool IKReverbAudioProcessor::isMidiLearning (const juce::String& parameterID) const
+{
+    auto index = getLearnableIndex(parameterID);
+    return index >= 0 && midiLearnTarget.load() == index;
+}
+
+void IKReverbAudioProcessor::loadImpulseResponse (const juce::File& file)
+{
+    apvts.state.setProperty(irFileProperty, file.getFullPathName(), nullptr);
+    convolutionReverb.loadImpulseResponse(file);
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -9,22 +9,35 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "CutFilter.h"
+#include "FDNReverb.h"
+#include "PreDelay.h"
+#include "Modulation.h"
+#include "HalfBandResampler.h"
+#include "ConvolutionReverb.h"
+#include "Surround.h"
+#include "FreezeLooper.h"
+#include "EarlyReflections.h"
+#include "SpringReverb.h"
+#include "PlateReverb.h"
+#include "WorkerPool.h"
+#include "Telemetry.h"
+#include "ReverbTypes.h"
 
 //==============================================================================
-/**
+/** Broadcasts a change message when a MIDI learn or mapping changes or a
+    new IR has been read, so the editor never has to poll for them.
 */
-class IKReverbAudioProcessor  : public juce::AudioProcessor
+class IKReverbAudioProcessor  : public juce::AudioProcessor,
+                                public juce::ChangeBroadcaster,
+                                private juce::ChangeListener,
+                                private juce::AudioProcessorValueTreeState::Listener,
+                                private juce::AsyncUpdater,
+                                private juce::Timer
 {
 public:
-    enum class ReverbType
-    {
-        Room,       // Small room reverb
-        Hall,       // Concert hall reverb
-        Plate,      // Plate reverb simulation
-        Spring,     // Spring reverb simulation
-        Shimmer,    // Shimmer reverb with pitch shifting
-        NumTypes
-    };
+    // The types and their traits live in ReverbTypes.h
+    using ReverbType = ::ReverbType;
 
     //==============================================================================
     IKReverbAudioProcessor();
@@ -35,12 +48,16 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
+    void setNonRealtime (bool isNonRealtime) noexcept override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -67,28 +84,278 @@ public:
 
     juce::AudioProcessorValueTreeState& getAPVTS() { return apvts; }
 
-    // Made public for visualization
-    float processShimmer(float input, float amount);
+    // Every parameter, loaded once from its atomic
+    struct ParameterSnapshot
+    {
+        float size = 0.5f;
+        float damping = 0.5f;
+        float predelayMs = 0.0f;
+        float mix = 0.3f;
+        float modulation = 0.0f;
+        float lowCut = 20.0f;
+        float highCut = 20000.0f;
+        int type = 0;
+        int interval = 3;
+        bool eco = false;
+        bool multiThreaded = false;
+        bool freeze = false;
+    };
+
+    /** Any thread: a snapshot of the current parameter values. */
+    ParameterSnapshot getParameterSnapshot() const noexcept;
+
+    /** Message thread: loads an IR file for the CONVOLUTION type in the
+        background and remembers it in the plugin state.
+    */
+    void loadImpulseResponse (const juce::File& file);
+    juce::String getImpulseResponseName() const { return convolutionReverb.getImpulseResponseName(); }
+    juce::String getImpulseResponsePath() const { return apvts.state.getProperty(irFileProperty).toString(); }
+
+    /** True until a requested IR is ready for the next processBlock. */
+    bool isLoadingImpulseResponse() const { return convolutionReverb.isBuilding(); }
+
+    // MIDI CC learn, for the controls worth playing live
+    static constexpr const char* learnableParameterIDs[] = { "size", "mix", "predelay", "freeze" };
+    enum LearnableIndex { learnSize, learnMix, learnPredelay, learnFreeze };    // Same order
+
+    /** Message thread: the next controller that moves gets this parameter. */
+    void beginMidiLearn (const juce::String& parameterID);
+    void cancelMidiLearn();
+    void clearMidiMapping (const juce::String& parameterID);
+
+    /** The controller assigned to a learnable parameter, or -1. */
+    int getMidiController (const juce::String& parameterID) const;
+    bool isMidiLearning (const juce::String& parameterID) const;
+    static int getLearnableIndex (const juce::String& parameterID);
+
+    /** Levels and the wet signal for the editor's meters and spectrum. */
+    Telemetry& getTelemetry() noexcept { return telemetry; }
 
     juce::AudioProcessorValueTreeState apvts;
     juce::dsp::Reverb reverb;
-    juce::dsp::DelayLine<float> preDelay { 192000 }; // 2 seconds at 96kHz
-    bool shimmerEnabled = false;
 
 private:
     //==============================================================================
+    static TankEngine getTankEngine (ReverbType type);
+
+    // Eco quality runs the wet path at a decimated rate above 80 kHz
+    static int getEcoFactor (double sampleRate, bool eco);
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void changeListenerCallback (juce::ChangeBroadcaster* source) override;
+
+    // Hands learned controller moves to the host, off the audio thread
+    void timerCallback() override;
+    bool hasMidiControl() const noexcept;    // A learn or a mapping is active
+    void midiControlChanged();               // Message thread: timer and listeners
+
+    // Both processBlock overloads run the same code at their own precision
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
+
+    // processBlock renders in sub-blocks between MIDI events. Each one
+    // dispatches once on the type into the kernel built for it
+    template <typename SampleType>
+    void processSubBlock (juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType, typename Traits>
+    void processSubBlock (juce::AudioBuffer<SampleType>& buffer, const ParameterSnapshot& snapshot);
+    void handleMidiMessage (const juce::MidiMessage& message) noexcept;
+    static constexpr int maxSubBlockSize = 256;
+
+    // Jobs for the worker pool; context is the processor
+    template <typename SampleType>
+    static void convolveChannel (void* context, int index) noexcept;
+    template <typename SampleType, TankEngine engine>
+    static void finishChannelGroup (void* context, int index) noexcept;
+    void runJobs (WorkerPool::Job job, int numJobs, bool parallel) noexcept;
+
+    // Raw parameter values, looked up once in the constructor
+    struct ParameterHandles
+    {
+        std::atomic<float>* size = nullptr;
+        std::atomic<float>* damping = nullptr;
+        std::atomic<float>* type = nullptr;
+        std::atomic<float>* interval = nullptr;
+        std::atomic<float>* predelay = nullptr;
+        std::atomic<float>* mix = nullptr;
+        std::atomic<float>* modulation = nullptr;
+        std::atomic<float>* quality = nullptr;
+        std::atomic<float>* lowCut = nullptr;
+        std::atomic<float>* highCut = nullptr;
+        std::atomic<float>* freeze = nullptr;
+        std::atomic<float>* threading = nullptr;
+    };
+
+    ParameterHandles parameters;
+
+    // Learned controllers: CC number -> index into learnableParameterIDs, or -1
+    std::array<juce::RangedAudioParameter*, std::size(learnableParameterIDs)> learnableParameters {};
+    std::array<std::atomic<int>, 128> controllerTargets;
+    std::atomic<int> midiLearnTarget { -1 };
+    int notifiedLearnTarget = -1;    // Message thread: the learn listeners last heard of
+
+    // The latest learned controller value for each learnable parameter
+    // (normalised), or -1 once the host has it. The audio thread only
+    // stores here; snapshots use it until timerCallback() has set the
+    // parameter
+    std::array<std::atomic<float>, std::size(learnableParameterIDs)> midiValues;
+    static constexpr int midiPushIntervalMs = 30;
+    static inline const juce::Identifier midiMapProperty { "midiMap" };
+
+    // Ramps for the continuous controls that the DSP doesn't already glide
+    // itself (pre-delay and the cutoffs do). The mix ramps per sample; the
+    // tank controls step along their ramp once per sub-block
+    static constexpr double smoothingSeconds = 0.05;
+    juce::SmoothedValue<float> sizeSmoothed, dampingSmoothed, modulationSmoothed, mixSmoothed;
+
     // Reverb parameters
     juce::dsp::Reverb::Parameters reverbParams;
+
+    // Pitch ratios for the "interval" choices: -12, +5, +7, +12, +19, +24 semitones
+    static constexpr float shimmerRatios[] = { 0.5f, 1.33484f, 1.49831f, 2.0f, 2.99661f, 4.0f };
+
+    // Impulse response reverb; the file path lives in the state tree
+    ConvolutionReverb convolutionReverb;
+    static inline const juce::Identifier irFileProperty { "irFile" };
+    int lastType = -1;
+
+    static constexpr double maxPreDelaySeconds = 0.5;   // Matches the "predelay" range
+    int numSendChannels = 2;
+    int lfeChannel = -1;
+    int ecoFactor = 1;
+
+    // Everything after the tank is per channel, so the bed is split into
+    // groups that the shared worker pool can finish side by side:
+    // surround taps, freeze, eco interpolation, dry delay and the mix
+    template <typename SampleType>
+    struct ChannelGroup
+    {
+        HalfBandResampler<SampleType> upsampler;
+        PreDelay<SampleType> dryDelay;
+        int firstChannel = 0;
+        int numChannels = 0;
+    };
+
+    // The current chunk, as the jobs see it
+    template <typename SampleType>
+    struct ChunkState
+    {
+        juce::dsp::AudioBlock<SampleType> tankBlock, tankSend, wetBlock, dryBlock;
+        juce::dsp::AudioBlock<float> floatSend;     // What the float-only tanks run on
+        bool tankRunning = true;
+        SampleType dryMix = 1;
+        SampleType wetMix = 0;
+        const SampleType* dryGains = nullptr;       // Per-sample mix while it ramps
+        const SampleType* wetGains = nullptr;
+    };
+
+    static constexpr int maxChannelGroups = 4;
+    static constexpr int minParallelSamples = 256;  // Shorter host blocks don't amortise the handoff
+
+    // Everything on the wet path that holds audio, at one precision. Only
+    // the path for the host's processing precision is prepared. The float
+    // tanks (juce::dsp::Reverb and the convolver) are shared: in double
+    // they run on a float copy of the send, and the rest stays in double
+    template <typename SampleType>
+    struct WetPath
+    {
+        // Low/high cut and pre-delay
+        CutFilter<SampleType> cutFilter;
+        PreDelay<SampleType> preDelay;
+
+        // FDN tanks for the types that want long, dense tails
+        FDNReverb<SampleType, 16> hallTank;
+        FDNReverb<SampleType, 8> shimmerTank;
+
+        // Spring and plate tanks
+        SpringReverb<SampleType> springTank;
+        PlateReverb<SampleType> plateTank;
+
+        // Modulation for the tanks that can't modulate their own delay lines
+        ChorusDelay<SampleType> wetChorus;
+
+        // Reflections off the walls, for the types built around a room
+        EarlyReflections<SampleType> earlyReflections;
+
+        // Freeze: loops the captured tail and lets the tank stop
+        FreezeLooper<SampleType> freezeLooper;
+
+        // Surround: the stereo send every tank reads, and the spreader that
+        // widens the stereo-only tanks to the full bed
+        SurroundSend<SampleType> surroundSend;
+        SurroundSpreader<SampleType> surroundSpreader;
+
+        // Eco mode: decimation into the wet path. Interpolating back up and
+        // the matching dry delay are done per channel group
+        HalfBandResampler<SampleType> ecoResampler;
+        std::array<ChannelGroup<SampleType>, maxChannelGroups> channelGroups;
+
+        // Working memory, sized in prepareToPlay so that processBlock never
+        // allocates. floatSend is only used by the double path
+        juce::AudioBuffer<SampleType> wetBuffer, earlyBuffer;
+        juce::AudioBuffer<float> floatSend;
+        std::vector<SampleType> dryGains, wetGains;
+
+        ChunkState<SampleType> chunk;
+    };
+
+    WetPath<float> floatPath;
+    WetPath<double> doublePath;
+
+    template <typename SampleType>
+    WetPath<SampleType>& getWetPath() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatPath;
+        else
+            return doublePath;
+    }
+
+    // The FDN behind an fdn8 or fdn16 engine
+    template <TankEngine engine, typename SampleType>
+    static auto& getFDNTank (WetPath<SampleType>& path) noexcept
+    {
+        static_assert(engine == TankEngine::fdn16 || engine == TankEngine::fdn8);
+
+        if constexpr (engine == TankEngine::fdn16)
+            return path.hallTank;
+        else
+            return path.shimmerTank;
+    }
+
+    template <typename SampleType>
+    void prepareWetPath (WetPath<SampleType>& path, const juce::dsp::ProcessSpec& spec, int samplesPerBlock);
+
+    template <typename SampleType>
+    void resetTank (WetPath<SampleType>& path, TankEngine engine) noexcept;
+
+    template <typename SampleType>
+    void resetWetPath (WetPath<SampleType>& path) noexcept;
+
+    // Runs the freeverb or convolution tank, converting around it in double
+    template <TankEngine engine, typename SampleType>
+    void processFloatTank (WetPath<SampleType>& path, bool parallel) noexcept;
+
+    juce::SharedResourcePointer<WorkerPool> workerPool;
+    int numChannelGroups = 1;
+    bool parallelHostBlock = false;     // Audio thread: MULTI may use the pool in this block
+
+    // Tail-aware sleep: with the input silent and the wet path decayed
+    // below the threshold, processBlock skips the wet path entirely
+    static constexpr float silenceThreshold = 3.0e-5f;     // About -90 dBFS
+    static constexpr double sleepHoldSeconds = 0.1;
+    bool wetPathAsleep = false;
+    int silentInputSamples = 0;
+    int quietWetSamples = 0;
+    int sleepHoldSamples = 0;
+
+    // Meters and spectrum feed; idle unless an editor is open
+    Telemetry telemetry;
+
+    float lastModulation = 0.0f;
     
-    // Filters
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> lowCutFilter;
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> highCutFilter;
-    
-    // Shimmer effect state
-    float shimmerMix = 0.0f;
-    float shimmerPhase = 0.0f;
-    
-    double currentSampleRate = 44100.0;
+    double currentSampleRate = 44100.0;     // Host rate
+    double internalSampleRate = 44100.0;    // Rate the wet path runs at
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (IKReverbAudioProcessor)
 };
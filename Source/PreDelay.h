@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    PreDelay.h
+
+    Multichannel fractional delay sized from the sample rate in prepare().
+    Each block is written into a power-of-two ring with at most two memcpy
+    spans. While the delay time is steady it is read back the same way, with
+    vectorised linear interpolation. While the time glides, the read is
+    per sample against one shared ramp of delay values.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class PreDelay
+{
+public:
+    PreDelay() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec, double maxDelaySeconds)
+    {
+        maxDelay = static_cast<SampleType>(std::ceil(maxDelaySeconds * spec.sampleRate));
+
+        // Room for the longest delay, the interpolation neighbour and the
+        // block that is written before it is read
+        size = juce::nextPowerOfTwo((int) maxDelay + (int) spec.maximumBlockSize + 2);
+        mask = size - 1;
+        buffer.setSize((int) spec.numChannels, size);
+        delayRamp.assign((size_t) spec.maximumBlockSize, SampleType(0));
+
+        delay.reset(spec.sampleRate, 0.05);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        buffer.clear();
+        writePos = 0;
+        delay.setCurrentAndTargetValue(delay.getTargetValue());
+    }
+
+    /** Sets the target delay in samples; it glides there over 50 ms. */
+    void setDelay(SampleType newDelaySamples) noexcept
+    {
+        delay.setTargetValue(juce::jlimit(SampleType(0), maxDelay, newDelaySamples));
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numChannels = juce::jmin((int) outputBlock.getNumChannels(), buffer.getNumChannels());
+        const auto numSamples = (int) outputBlock.getNumSamples();
+
+        jassert(numSamples <= (int) delayRamp.size());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            writeSpan(buffer.getWritePointer(channel), inputBlock.getChannelPointer((size_t) channel), numSamples);
+
+        if (delay.isSmoothing())
+        {
+            for (int i = 0; i < numSamples; ++i)
+                delayRamp[(size_t) i] = delay.getNextValue();
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                readRamped(buffer.getReadPointer(channel), outputBlock.getChannelPointer((size_t) channel), numSamples);
+        }
+        else if (delay.getTargetValue() > SampleType(0) || context.usesSeparateInputAndOutputBlocks())
+        {
+            // A zero delay in place leaves the block as it is
+            for (int channel = 0; channel < numChannels; ++channel)
+                readFixed(buffer.getReadPointer(channel), outputBlock.getChannelPointer((size_t) channel), numSamples);
+        }
+
+        writePos = (writePos + numSamples) & mask;
+    }
+
+private:
+    void writeSpan(SampleType* ring, const SampleType* source, int numSamples) noexcept
+    {
+        const auto first = juce::jmin(numSamples, size - writePos);
+        std::memcpy(ring + writePos, source, sizeof(SampleType) * (size_t) first);
+        std::memcpy(ring, source + first, sizeof(SampleType) * (size_t) (numSamples - first));
+    }
+
+    // dest (+)= ring[pos .. pos + numSamples) * gain, split at the wrap
+    void readSpan(const SampleType* ring, int pos, SampleType* dest, int numSamples, SampleType gain, bool add) const noexcept
+    {
+        pos &= mask;
+        const auto first = juce::jmin(numSamples, size - pos);
+
+        if (add)
+        {
+            juce::FloatVectorOperations::addWithMultiply(dest, ring + pos, gain, first);
+            juce::FloatVectorOperations::addWithMultiply(dest + first, ring, gain, numSamples - first);
+        }
+        else
+        {
+            juce::FloatVectorOperations::copyWithMultiply(dest, ring + pos, gain, first);
+            juce::FloatVectorOperations::copyWithMultiply(dest + first, ring, gain, numSamples - first);
+        }
+    }
+
+    void readFixed(const SampleType* ring, SampleType* dest, int numSamples) const noexcept
+    {
+        const auto d = delay.getTargetValue();
+        const auto whole = (int) d;
+        const auto frac = d - SampleType(whole);
+        const auto start = writePos - whole;
+
+        readSpan(ring, start, dest, numSamples, SampleType(1) - frac, false);
+
+        if (frac > SampleType(0))
+            readSpan(ring, start - 1, dest, numSamples, frac, true);
+    }
+
+    void readRamped(const SampleType* ring, SampleType* dest, int numSamples) const noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto d = delayRamp[(size_t) i];
+            const auto whole = (int) d;
+            const auto frac = d - SampleType(whole);
+            const auto pos = writePos + i - whole;
+            const auto a = ring[pos & mask];
+            const auto b = ring[(pos - 1) & mask];
+
+            dest[i] = a + (b - a) * frac;
+        }
+    }
+
+    juce::AudioBuffer<SampleType> buffer;
+    std::vector<SampleType> delayRamp;
+    juce::SmoothedValue<SampleType> delay;
+    SampleType maxDelay = SampleType(0);
+    int size = 0;
+    int mask = 0;
+    int writePos = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PreDelay)
+};
@@ -0,0 +1,267 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.cpp
+
+    Replaces the global allocator (and, on glibc, the C allocator and the
+    pthread/semaphore blocking calls) with thin shims that report a violation
+    whenever they are hit from inside a ScopedAudioThread.
+
+    Hooks installed per platform:
+      - everywhere:   operator new / delete (all C++17 overloads)
+      - Linux/glibc:  malloc, calloc, realloc, free, posix_memalign,
+                      aligned_alloc, memalign, pthread_mutex_lock,
+                      pthread_rwlock_rdlock/wrlock, sem_wait
+
+    The libc hooks only take effect in executables (the benchmark and test
+    tools); inside a host the plugin still traps its own operator new calls.
+
+  ==============================================================================
+*/
+
+#include "RealtimeSafetyChecker.h"
+
+#if IKREVERB_RT_CHECKS
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined (__linux__) && defined (__GLIBC__)
+ #define IKREVERB_RT_HOOK_LIBC 1
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+
+ extern "C" void* __libc_malloc (size_t);
+ extern "C" void* __libc_calloc (size_t, size_t);
+ extern "C" void* __libc_realloc (void*, size_t);
+ extern "C" void* __libc_memalign (size_t, size_t);
+ extern "C" void  __libc_free (void*);
+#else
+ #define IKREVERB_RT_HOOK_LIBC 0
+#endif
+
+#if defined (__GNUC__)
+ // Initial-exec TLS never calls back into malloc on first access.
+ #define IKREVERB_RT_TLS __thread __attribute__ ((tls_model ("initial-exec")))
+#else
+ #define IKREVERB_RT_TLS thread_local
+#endif
+
+namespace
+{
+    IKREVERB_RT_TLS int audioCallbackDepth = 0;
+    IKREVERB_RT_TLS int disabledDepth = 0;
+
+    std::atomic<int> numViolations { 0 };
+    std::atomic<RealtimeSafetyChecker::Mode> checkerMode { RealtimeSafetyChecker::Mode::abortOnViolation };
+
+    inline void check (const char* what) noexcept
+    {
+        if (audioCallbackDepth > 0 && disabledDepth == 0)
+            RealtimeSafetyChecker::reportViolation (what);
+    }
+
+    //==============================================================================
+    inline void* rawAllocate (std::size_t size) noexcept
+    {
+       #if IKREVERB_RT_HOOK_LIBC
+        return __libc_malloc (size);
+       #else
+        return std::malloc (size);
+       #endif
+    }
+
+    inline void rawFree (void* ptr) noexcept
+    {
+       #if IKREVERB_RT_HOOK_LIBC
+        __libc_free (ptr);
+       #else
+        std::free (ptr);
+       #endif
+    }
+
+    inline void* rawAllocateAligned (std::size_t size, std::size_t alignment) noexcept
+    {
+       #if IKREVERB_RT_HOOK_LIBC
+        return __libc_memalign (alignment, size);
+       #elif defined (_WIN32)
+        return _aligned_malloc (size, alignment);
+       #else
+        void* ptr = nullptr;
+        return posix_memalign (&ptr, alignment, size) == 0 ? ptr : nullptr;
+       #endif
+    }
+
+    inline void rawFreeAligned (void* ptr) noexcept
+    {
+       #if defined (_WIN32)
+        _aligned_free (ptr);
+       #else
+        rawFree (ptr);
+       #endif
+    }
+
+    void* checkedNew (std::size_t size, const char* what)
+    {
+        check (what);
+
+        if (auto* ptr = rawAllocate (size != 0 ? size : 1))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void* checkedAlignedNew (std::size_t size, std::align_val_t alignment, const char* what)
+    {
+        check (what);
+
+        if (auto* ptr = rawAllocateAligned (size != 0 ? size : 1, static_cast<std::size_t> (alignment)))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+}
+
+//==============================================================================
+void RealtimeSafetyChecker::setMode (Mode newMode) noexcept     { checkerMode = newMode; }
+int RealtimeSafetyChecker::getNumViolations() noexcept          { return numViolations.load(); }
+void RealtimeSafetyChecker::resetViolations() noexcept          { numViolations = 0; }
+bool RealtimeSafetyChecker::isInsideAudioCallback() noexcept    { return audioCallbackDepth > 0; }
+
+void RealtimeSafetyChecker::reportViolation (const char* what) noexcept
+{
+    ++numViolations;
+
+    if (checkerMode.load() == Mode::countViolations)
+        return;
+
+    // Printing may itself allocate, so drop out of checked mode first.
+    ++disabledDepth;
+    std::fprintf (stderr, "IKReverb RT-safety violation: %s called inside processBlock\n", what);
+    std::fflush (stderr);
+    std::abort();
+}
+
+RealtimeSafetyChecker::ScopedAudioThread::ScopedAudioThread() noexcept   { ++audioCallbackDepth; }
+RealtimeSafetyChecker::ScopedAudioThread::~ScopedAudioThread() noexcept  { --audioCallbackDepth; }
+
+RealtimeSafetyChecker::ScopedDisable::ScopedDisable() noexcept           { ++disabledDepth; }
+RealtimeSafetyChecker::ScopedDisable::~ScopedDisable() noexcept          { --disabledDepth; }
+
+//==============================================================================
+void* operator new (std::size_t size)                                         { return checkedNew (size, "operator new"); }
+void* operator new[] (std::size_t size)                                       { return checkedNew (size, "operator new[]"); }
+void* operator new (std::size_t size, std::align_val_t al)                    { return checkedAlignedNew (size, al, "operator new"); }
+void* operator new[] (std::size_t size, std::align_val_t al)                  { return checkedAlignedNew (size, al, "operator new[]"); }
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    check ("operator new");
+    return rawAllocate (size != 0 ? size : 1);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept
+{
+    check ("operator new[]");
+    return rawAllocate (size != 0 ? size : 1);
+}
+
+void operator delete (void* ptr) noexcept                                     { if (ptr != nullptr) { check ("operator delete");   rawFree (ptr); } }
+void operator delete[] (void* ptr) noexcept                                   { if (ptr != nullptr) { check ("operator delete[]"); rawFree (ptr); } }
+void operator delete (void* ptr, std::size_t) noexcept                        { operator delete (ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept                      { operator delete[] (ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept              { operator delete (ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept            { operator delete[] (ptr); }
+void operator delete (void* ptr, std::align_val_t) noexcept                   { if (ptr != nullptr) { check ("operator delete");   rawFreeAligned (ptr); } }
+void operator delete[] (void* ptr, std::align_val_t) noexcept                 { if (ptr != nullptr) { check ("operator delete[]"); rawFreeAligned (ptr); } }
+void operator delete (void* ptr, std::size_t, std::align_val_t al) noexcept   { operator delete (ptr, al); }
+void operator delete[] (void* ptr, std::size_t, std::align_val_t al) noexcept { operator delete[] (ptr, al); }
+
+//==============================================================================
+#if IKREVERB_RT_HOOK_LIBC
+extern "C"
+{
+    void* malloc (size_t size)                  { check ("malloc");  return __libc_malloc (size); }
+    void* calloc (size_t num, size_t size)      { check ("calloc");  return __libc_calloc (num, size); }
+    void* realloc (void* ptr, size_t size)      { check ("realloc"); return __libc_realloc (ptr, size); }
+    void  free (void* ptr)                      { if (ptr != nullptr) check ("free"); __libc_free (ptr); }
+
+    // SIMD and FFT buffers tend to come from the aligned allocators, which
+    // glibc serves from the same heap
+    void* memalign (size_t alignment, size_t size)          { check ("memalign");      return __libc_memalign (alignment, size); }
+    void* aligned_alloc (size_t alignment, size_t size)     { check ("aligned_alloc"); return __libc_memalign (alignment, size); }
+
+    int posix_memalign (void** ptr, size_t alignment, size_t size)
+    {
+        check ("posix_memalign");
+
+        if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0)
+            return EINVAL;
+
+        auto* block = __libc_memalign (alignment, size);
+
+        if (block == nullptr)
+            return ENOMEM;
+
+        *ptr = block;
+        return 0;
+    }
+}
+
+namespace
+{
+    // Resolved lazily without a function-local static, whose guard could
+    // itself end up in one of the hooks below.
+    template <typename FunctionType>
+    FunctionType resolveNext (std::atomic<void*>& cache, const char* name) noexcept
+    {
+        auto* fn = cache.load (std::memory_order_acquire);
+
+        if (fn == nullptr)
+        {
+            fn = dlsym (RTLD_NEXT, name);
+            cache.store (fn, std::memory_order_release);
+        }
+
+        return reinterpret_cast<FunctionType> (fn);
+    }
+
+    std::atomic<void*> realMutexLock { nullptr }, realRwlockRdlock { nullptr },
+                       realRwlockWrlock { nullptr }, realSemWait { nullptr };
+}
+
+extern "C"
+{
+    // Waiting on a condition variable needs the mutex first, so trapping the
+    // lock calls covers pthread_cond_wait and every juce/std wrapper on top.
+    int pthread_mutex_lock (pthread_mutex_t* mutex)
+    {
+        check ("pthread_mutex_lock");
+        return resolveNext<int (*) (pthread_mutex_t*)> (realMutexLock, "pthread_mutex_lock") (mutex);
+    }
+
+    int pthread_rwlock_rdlock (pthread_rwlock_t* lock)
+    {
+        check ("pthread_rwlock_rdlock");
+        return resolveNext<int (*) (pthread_rwlock_t*)> (realRwlockRdlock, "pthread_rwlock_rdlock") (lock);
+    }
+
+    int pthread_rwlock_wrlock (pthread_rwlock_t* lock)
+    {
+        check ("pthread_rwlock_wrlock");
+        return resolveNext<int (*) (pthread_rwlock_t*)> (realRwlockWrlock, "pthread_rwlock_wrlock") (lock);
+    }
+
+    int sem_wait (sem_t* semaphore)
+    {
+        check ("sem_wait");
+        return resolveNext<int (*) (sem_t*)> (realSemWait, "sem_wait") (semaphore);
+    }
+}
+#endif
+
+#endif // IKREVERB_RT_CHECKS
@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.h
+
+    Debug/test mode that traps heap allocations and blocking lock calls made
+    while the audio thread is inside processBlock, or while a worker thread
+    runs one of its WorkerPool jobs.
+
+    Enable it by compiling with IKREVERB_RT_CHECKS=1. When disabled, every
+    call in here compiles down to nothing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#ifndef IKREVERB_RT_CHECKS
+ #define IKREVERB_RT_CHECKS 0
+#endif
+
+class RealtimeSafetyChecker
+{
+public:
+    enum class Mode
+    {
+        abortOnViolation,   // Print the offending call and abort (default)
+        countViolations     // Only count, so a benchmark can report them
+    };
+
+   #if IKREVERB_RT_CHECKS
+    static void setMode (Mode newMode) noexcept;
+    static int getNumViolations() noexcept;
+    static void resetViolations() noexcept;
+
+    // Called by the hooks; public so the platform shims can reach it.
+    static bool isInsideAudioCallback() noexcept;
+    static void reportViolation (const char* what) noexcept;
+
+    /** Marks the current thread as running the audio callback (or a job
+        for it) for its lifetime.
+    */
+    struct ScopedAudioThread
+    {
+        ScopedAudioThread() noexcept;
+        ~ScopedAudioThread() noexcept;
+    };
+
+    /** Temporarily lifts the checks, e.g. around a deliberate debug print. */
+    struct ScopedDisable
+    {
+        ScopedDisable() noexcept;
+        ~ScopedDisable() noexcept;
+    };
+   #else
+    static void setMode (Mode) noexcept {}
+    static int getNumViolations() noexcept { return 0; }
+    static void resetViolations() noexcept {}
+
+    struct ScopedAudioThread { ScopedAudioThread() noexcept {} };
+    struct ScopedDisable     { ScopedDisable() noexcept {} };
+   #endif
+};
@@ -0,0 +1,168 @@
+/*
+  ==============================================================================
+
+    ReverbTypes.h
+
+    The reverb types, and how each one is built, fixed at compile time.
+
+    Every ReverbType has a ReverbTypeTraits specialization. It names the
+    tank the type runs on and the optional stages around it, and holds the
+    type's tuning: how "size" and "damping" map onto the tank, and its
+    stereo width. The processor switches on the type once per sub-block,
+    through dispatchReverbType(), into a kernel instantiated for that
+    type. Each kernel is compiled with only the stages its type uses and
+    with its constants folded in.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "EarlyReflections.h"
+
+enum class ReverbType
+{
+    Room,       // Small room reverb
+    Hall,       // Concert hall reverb
+    Plate,      // Plate reverb simulation
+    Spring,     // Spring reverb simulation
+    Shimmer,    // Shimmer reverb with pitch shifting
+    Convolution,    // Loaded impulse response
+    NumTypes
+};
+
+// The tanks the types run on
+enum class TankEngine
+{
+    freeverb,   // juce::dsp::Reverb
+    fdn8,       // 8-line FDN
+    fdn16,      // 16-line FDN
+    spring,     // Dispersive allpass loops
+    plate,      // Dattorro figure-eight tank
+    convolution // Partitioned IR convolution
+};
+
+// Tanks with a stereo output and no modulation of their own get the
+// chorus, and the surround spreader for the rest of the bed
+struct StereoTankStages
+{
+    static constexpr bool hasChorus = true;
+    static constexpr bool hasSpreader = true;
+    static constexpr bool hasEarlyReflections = false;
+};
+
+// The FDNs modulate their own lines and tap them for every channel
+struct FDNTankStages
+{
+    static constexpr bool hasChorus = false;
+    static constexpr bool hasSpreader = false;
+    static constexpr bool hasEarlyReflections = false;
+};
+
+template <ReverbType type>
+struct ReverbTypeTraits;
+
+// Early reflections from the room's walls carry the sense of space; they
+// feed a small tank for the late tail and go to the output themselves
+template <>
+struct ReverbTypeTraits<ReverbType::Room> : StereoTankStages
+{
+    static constexpr TankEngine engine = TankEngine::freeverb;
+    static constexpr float roomSizeScale = 0.25f;
+    static constexpr float dampingScale = 0.9f;
+    static constexpr float width = 0.5f;
+
+    static constexpr bool hasEarlyReflections = true;
+    static constexpr float earlyLevel = 0.7f;   // Reflections straight to the output
+
+    // 2.5 x 3.5 x 2.1 m at size 0, up to 7.5 x 10.5 x 3.3 m at size 1.
+    // Damping softens the walls
+    static RoomGeometry getGeometry(float size, float damping)
+    {
+        RoomGeometry geometry;
+        geometry.width = 2.5f + 5.0f * size;
+        geometry.depth = 3.5f + 7.0f * size;
+        geometry.height = 2.1f + 1.2f * size;
+        geometry.reflectivity = 0.9f - 0.35f * damping;
+        return geometry;
+    }
+};
+
+template <>
+struct ReverbTypeTraits<ReverbType::Hall> : FDNTankStages
+{
+    static constexpr TankEngine engine = TankEngine::fdn16;
+    static constexpr double lineScale = 1.0;    // FDN line lengths, 1 = large hall
+    static constexpr float dampingScale = 0.6f;
+    static constexpr float width = 1.0f;
+    static constexpr float shimmer = 0.0f;
+
+    static float getDecaySeconds(float size) { return 0.6f * std::pow(20.0f, size); }     // 0.6 s - 12 s
+};
+
+// The plate modulates its own tank allpasses. Plates are bright, so
+// damping only goes part of the way
+template <>
+struct ReverbTypeTraits<ReverbType::Plate> : StereoTankStages
+{
+    static constexpr TankEngine engine = TankEngine::plate;
+    static constexpr bool hasChorus = false;
+    static constexpr float dampingScale = 0.5f;
+    static constexpr float width = 1.0f;
+    static constexpr float minModulation = 0.25f;  // Keeps the tail from ringing metallic
+
+    static float getDecaySeconds(float size) { return 0.5f * std::pow(12.0f, size); }     // 0.5 s - 6 s
+};
+
+// The springs drip on their own, so modulation drives that instead of
+// the chorus
+template <>
+struct ReverbTypeTraits<ReverbType::Spring> : StereoTankStages
+{
+    static constexpr TankEngine engine = TankEngine::spring;
+    static constexpr bool hasChorus = false;
+    static constexpr float dampingScale = 0.6f;
+    static constexpr float minDrip = 0.15f;     // Real springs always drip a little
+
+    static float getDecaySeconds(float size) { return 1.2f + 2.8f * size; }     // 1.2 s - 4 s
+};
+
+template <>
+struct ReverbTypeTraits<ReverbType::Shimmer> : FDNTankStages
+{
+    static constexpr TankEngine engine = TankEngine::fdn8;
+    static constexpr double lineScale = 1.3;
+    static constexpr float dampingScale = 0.5f;
+    static constexpr float width = 1.0f;
+    static constexpr float shimmer = 0.6f;     // Share of the feedback that is pitch shifted
+
+    static float getDecaySeconds(float size) { return 1.2f * std::pow(16.0f, size); }     // 1.2 s - 19 s
+};
+
+// The IR defines size and damping
+template <>
+struct ReverbTypeTraits<ReverbType::Convolution> : StereoTankStages
+{
+    static constexpr TankEngine engine = TankEngine::convolution;
+};
+
+/** Calls function with ReverbTypeTraits<type>{} for a type known only at
+    run time. This is the one switch on the type; everything behind it is
+    resolved at compile time.
+*/
+template <typename Function>
+decltype(auto) dispatchReverbType(ReverbType type, Function&& function)
+{
+    switch (type)
+    {
+        case ReverbType::Hall:          return function(ReverbTypeTraits<ReverbType::Hall>{});
+        case ReverbType::Plate:         return function(ReverbTypeTraits<ReverbType::Plate>{});
+        case ReverbType::Spring:        return function(ReverbTypeTraits<ReverbType::Spring>{});
+        case ReverbType::Shimmer:       return function(ReverbTypeTraits<ReverbType::Shimmer>{});
+        case ReverbType::Convolution:   return function(ReverbTypeTraits<ReverbType::Convolution>{});
+        case ReverbType::Room:
+        case ReverbType::NumTypes:
+        default:                        return function(ReverbTypeTraits<ReverbType::Room>{});
+    }
+}
@@ -0,0 +1,317 @@
+/*
+  ==============================================================================
+
+    SpringReverb.h
+
+    Spring tank after the parametric spring models: each spring is a
+    delay loop whose round trip runs through a long cascade of stretched
+    first-order allpasses,
+
+        H(z) = (a + z^-K) / (1 + a z^-K)
+
+    The cascade is what makes a spring chirp. Its group delay peaks in
+    bands that repeat every fs / K, so with K set from the spring's
+    transition frequency each echo comes back as a falling chirp, and
+    because the cascade is inside the loop every trip disperses it more.
+    A slow, slightly detuned sweep of the loop delay adds the "drip".
+
+    The tank runs four springs, two per channel, with their own lengths
+    and coefficients, in the lanes of juce::dsp::SIMDRegister. Every
+    allpass section therefore updates all four springs with one subtract,
+    multiply and add per sample. The cascade is also pipelined: each
+    section works on what the one before it produced a sample earlier,
+    so the sections don't wait on each other within a sample and run at
+    the CPU's throughput rather than its latency. The 119 samples this
+    adds are taken off the loop delay. The sections' inputs are stored by
+    time step, so one sample's pass through the cascade walks a few
+    contiguous rows of registers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Modulation.h"
+
+template <typename SampleType>
+class SpringReverb
+{
+public:
+    struct Parameters
+    {
+        SampleType decaySeconds = SampleType(2);    // RT60 of the loops
+        SampleType damping = SampleType(0.5);       // 0 = bright, 1 = dark
+        SampleType length = SampleType(0.5);        // 0..1, short to long springs
+        SampleType drip = SampleType(0.2);          // 0..1 of the maximum loop sweep
+        SampleType dripRate = SampleType(0.8);      // Hz
+    };
+
+    SpringReverb() = default;
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+
+        // Chirps below the transition frequency; K also repeats them above
+        stretch = juce::jlimit(1, maxStretch, juce::roundToInt(sampleRate / (2.0 * transitionHz)));
+        historyRows = stretch + 1;
+
+        historyStorage.allocate((size_t) historyRows * rowLength + lanes, true);
+        history = Vec::getNextSIMDAlignedPtr(historyStorage.get());
+
+        maxDrip = static_cast<SampleType>(maxDripMs * 0.001 * sampleRate);
+        const auto longest = (maxLoopMs * maxSpringScale) * 0.001 * sampleRate + 2.0 * maxDrip;
+        const auto rows = juce::nextPowerOfTwo((int) std::ceil(longest) + 2);
+        mask = rows - 1;
+
+        loopStorage.allocate((size_t) rows * stride + lanes, true);
+        loop = Vec::getNextSIMDAlignedPtr(loopStorage.get());
+
+        alignas(Vec) SampleType a[stride] = {};
+
+        for (int i = 0; i < numSprings; ++i)
+            a[i] = static_cast<SampleType>(allpassCoeffs[i]);
+
+        for (size_t v = 0; v < numVecs; ++v)
+            allpassCoeff[v] = Vec::fromRawArray(a + v * lanes);
+
+        glideSamples = juce::jmax(1, juce::roundToInt(glideSeconds * sampleRate));
+
+        lfo.prepare(sampleRate);
+        lastParameters.decaySeconds = SampleType(-1);   // Force a full coefficient update
+        lastParameters.damping = SampleType(-1);
+        lastParameters.length = SampleType(-1);
+        setParameters(parameters);
+
+        for (size_t v = 0; v < numVecs; ++v)
+            baseDelay[v] = targetDelay[v];
+
+        glideRemaining = 0;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (history != nullptr)
+            std::fill(history, history + (size_t) historyRows * rowLength, SampleType(0));
+
+        if (loop != nullptr)
+            std::fill(loop, loop + (size_t) (mask + 1) * stride, SampleType(0));
+
+        for (auto& v : dampState)
+            v = Vec::expand(SampleType(0));
+
+        lfo.reset();
+        historyPos = 0;
+        writePos = 0;
+    }
+
+    void setParameters(const Parameters& newParameters) noexcept
+    {
+        parameters = newParameters;
+
+        if (sampleRate <= 0.0)
+            return;
+
+        if (parameters.length != lastParameters.length || parameters.decaySeconds != lastParameters.decaySeconds)
+        {
+            alignas(Vec) SampleType d[stride] = {}, g[stride] = {};
+            const auto loopMs = minLoopMs + (maxLoopMs - minLoopMs) * juce::jlimit(0.0, 1.0, (double) parameters.length);
+            const auto rt60 = juce::jmax(0.05, (double) parameters.decaySeconds);
+
+            for (int i = 0; i < numSprings; ++i)
+            {
+                // The cascade's pipeline is part of the round trip
+                const auto samples = loopMs * springScales[i] * 0.001 * sampleRate;
+                d[i] = static_cast<SampleType>(juce::jmax(1.0, samples - pipelineDelay));
+                g[i] = static_cast<SampleType>(std::pow(10.0, -3.0 * samples / (rt60 * sampleRate)));
+            }
+
+            // The loops glide to a new length in a straight line, so they
+            // land on it exactly rather than creeping up on it
+            for (size_t v = 0; v < numVecs; ++v)
+            {
+                targetDelay[v] = Vec::fromRawArray(d + v * lanes);
+                delayStep[v] = (targetDelay[v] - baseDelay[v]) * Vec::expand(SampleType(1) / SampleType(glideSamples));
+                decayGain[v] = Vec::fromRawArray(g + v * lanes);
+            }
+
+            glideRemaining = glideSamples;
+        }
+
+        if (parameters.damping != lastParameters.damping)
+        {
+            // One-pole lowpass per loop, from ~6 kHz (bright) down to ~1.5 kHz
+            const auto cutoff = 6000.0 * std::pow(1500.0 / 6000.0, (double) parameters.damping);
+            const auto coeff = static_cast<SampleType>(1.0 - std::exp(-juce::MathConstants<double>::twoPi
+                                                                       * juce::jmin(cutoff, 0.45 * sampleRate) / sampleRate));
+            for (auto& v : dampCoeff)
+                v = Vec::expand(coeff);
+        }
+
+        dripSweep = Vec::expand(juce::jlimit(SampleType(0), SampleType(1), parameters.drip) * maxDrip);
+        lfo.setRate(parameters.dripRate, dripSpread);
+        lastParameters = parameters;
+    }
+
+    /** Stereo in, stereo out; a mono block feeds and hears all four springs. */
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numChannels = outputBlock.getNumChannels();
+        const auto numSamples = outputBlock.getNumSamples();
+
+        if (numChannels == 0 || context.isBypassed)
+            return;
+
+        const auto* inL = inputBlock.getChannelPointer(0);
+        const auto* inR = inputBlock.getChannelPointer(juce::jmin((size_t) 1, inputBlock.getNumChannels() - 1));
+        auto* outL = outputBlock.getChannelPointer(0);
+        auto* outR = numChannels > 1 ? outputBlock.getChannelPointer(1) : nullptr;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            const auto left = inL[i] * inputGain;
+            const auto right = inR[i] * inputGain;
+            alignas(Vec) SampleType springIn[stride] = { left, left, right, right };
+            alignas(Vec) SampleType springOut[stride] = {};
+
+            processSample(springIn, springOut);
+
+            const auto l = (springOut[0] + springOut[1]) * SampleType(0.5);
+            const auto r = (springOut[2] + springOut[3]) * SampleType(0.5);
+
+            if (outR != nullptr)
+            {
+                outL[i] = l;
+                outR[i] = r;
+            }
+            else
+            {
+                outL[i] = (l + r) * SampleType(0.5);
+            }
+        }
+    }
+
+private:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+    static constexpr int numSprings = 4;            // Two per channel
+    static constexpr int numSections = 120;         // Allpasses per loop
+    static constexpr size_t lanes = Vec::size();
+    static constexpr size_t numVecs = ((size_t) numSprings + lanes - 1) / lanes;
+    static constexpr size_t stride = numVecs * lanes;
+    static constexpr size_t rowLength = (size_t) (numSections + 1) * stride;   // One time step of history
+    static constexpr int pipelineDelay = numSections - 1;   // Sections each run a sample behind the last
+
+    inline void processSample(const SampleType* springIn, SampleType* springOut) noexcept
+    {
+        // The loop read sweeps around its gliding length
+        lfo.advance();
+        const auto one = Vec::expand(SampleType(1));
+        alignas(Vec) SampleType delays[stride] = {};
+
+        if (glideRemaining > 0)
+        {
+            // Counted back from the target, so no rounding builds up
+            const auto remaining = Vec::expand(SampleType(--glideRemaining));
+
+            for (size_t v = 0; v < numVecs; ++v)
+                baseDelay[v] = targetDelay[v] - delayStep[v] * remaining;
+        }
+
+        for (size_t v = 0; v < numVecs; ++v)
+            (baseDelay[v] + dripSweep * (one + lfo.sine(v))).copyToRawArray(delays + v * lanes);
+
+        alignas(Vec) SampleType taps[stride] = {};
+
+        for (int i = 0; i < numSprings; ++i)
+        {
+            const auto whole = (int) delays[i];
+            const auto frac = delays[i] - SampleType(whole);
+            const auto a = loop[(size_t) ((writePos - whole) & mask) * stride + (size_t) i];
+            const auto b = loop[(size_t) ((writePos - whole - 1) & mask) * stride + (size_t) i];
+            taps[i] = a + (b - a) * frac;
+        }
+
+        // Rows hold times n, n - K (where n + 1 is written) and n - K + 1
+        const auto oldPos = historyPos + 1 == historyRows ? 0 : historyPos + 1;
+        const auto nextPos = oldPos + 1 == historyRows ? 0 : oldPos + 1;
+        auto* now = history + (size_t) historyPos * rowLength;
+        auto* old = history + (size_t) oldPos * rowLength;
+        const auto* next = history + (size_t) nextPos * rowLength;
+        auto* loopRow = loop + (size_t) writePos * stride;
+
+        std::copy(taps, taps + stride, now);
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            // y = a (x - y[n-K]) + x[n-K], for every section at once: each
+            // reads what the one before it made last sample, so nothing
+            // chains within a sample. Going backwards, a section's inputs
+            // are read before the section in front overwrites them
+            for (int s = numSections - 1; s >= 0; --s)
+            {
+                const auto offset = (size_t) s * stride + v * lanes;
+                const auto x = Vec::fromRawArray(now + offset);
+                const auto pastIn = Vec::fromRawArray(old + offset);
+                const auto pastOut = Vec::fromRawArray(next + offset + stride);
+                (allpassCoeff[v] * (x - pastOut) + pastIn).copyToRawArray(old + offset + stride);
+            }
+
+            const auto x = Vec::fromRawArray(old + (size_t) numSections * stride + v * lanes);
+            x.copyToRawArray(springOut + v * lanes);
+
+            dampState[v] += (x - dampState[v]) * dampCoeff[v];
+            (Vec::fromRawArray(springIn + v * lanes) + dampState[v] * decayGain[v]).copyToRawArray(loopRow + v * lanes);
+        }
+
+        historyPos = oldPos;
+
+        writePos = (writePos + 1) & mask;
+    }
+
+    //==============================================================================
+    static constexpr double transitionHz = 4300.0;
+    static constexpr int maxStretch = 16;
+    static constexpr double minLoopMs = 30.0;
+    static constexpr double maxLoopMs = 65.0;
+    static constexpr double maxDripMs = 1.2;
+    static constexpr double glideSeconds = 0.05;
+    static constexpr SampleType dripSpread = SampleType(0.3);  // Rate spread across the springs
+    static constexpr SampleType inputGain = SampleType(0.5);
+
+    // Left pair, right pair; no two springs share a length
+    static constexpr double springScales[numSprings] = { 1.0, 1.13, 0.94, 1.07 };
+    static constexpr double maxSpringScale = 1.13;
+    static constexpr double allpassCoeffs[numSprings] = { 0.63, 0.6, 0.61, 0.65 };
+
+    double sampleRate = 0.0;
+    Parameters parameters, lastParameters;
+
+    // Section inputs: K + 1 rows, one per time step, of (numSections + 1)
+    // registers. Section s reads column s and writes column s + 1
+    juce::HeapBlock<SampleType> historyStorage;
+    SampleType* history = nullptr;
+    int stretch = 1;
+    int historyRows = 2;
+    int historyPos = 0;
+
+    // The loops, one interleaved row of springs per sample
+    juce::HeapBlock<SampleType> loopStorage;
+    SampleType* loop = nullptr;
+    int mask = 0;
+    int writePos = 0;
+
+    Vec allpassCoeff[numVecs], decayGain[numVecs], dampCoeff[numVecs], dampState[numVecs];
+    Vec baseDelay[numVecs], targetDelay[numVecs], delayStep[numVecs], dripSweep;
+    int glideSamples = 1;
+    int glideRemaining = 0;
+    SampleType maxDrip = SampleType(0);
+    QuadratureLFO<SampleType, numSprings> lfo;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpringReverb)
+};
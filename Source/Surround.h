@@ -0,0 +1,296 @@
+/*
+  ==============================================================================
+
+    Surround.h
+
+    Helpers for running the wet path on multichannel beds (up to 7.1.4).
+
+    Every layout shares one stereo tank input. SurroundSend folds the bed
+    down to that L/R send by each channel's side of the room; the LFE gets
+    no send. The tank then produces the extra outputs itself: the FDN taps
+    its lines with a separate pattern per channel, and the stereo-only
+    tanks go through a SurroundSpreader.
+
+    SurroundSpreader derives channels 2 and up from a stereo pair. Each
+    channel has its own chain of Schroeder allpasses with different
+    lengths. All channels share one interleaved ring per stage (one row per
+    time step, one lane per channel), so the filter maths for the whole bed
+    runs in juce::dsp::SIMDRegister lanes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+struct SurroundLayout
+{
+    static constexpr int maxChannels = 12;      // 7.1.4
+
+    static bool isSupported(const juce::AudioChannelSet& set)
+    {
+        for (const auto& supported : { juce::AudioChannelSet::mono(),
+                                       juce::AudioChannelSet::stereo(),
+                                       juce::AudioChannelSet::createLCR(),
+                                       juce::AudioChannelSet::quadraphonic(),
+                                       juce::AudioChannelSet::create5point0(),
+                                       juce::AudioChannelSet::create5point1(),
+                                       juce::AudioChannelSet::create7point0(),
+                                       juce::AudioChannelSet::create7point1(),
+                                       juce::AudioChannelSet::create7point0point4(),
+                                       juce::AudioChannelSet::create7point1point4() })
+            if (set == supported)
+                return true;
+
+        return false;
+    }
+
+    /** 0 is hard left, 1 hard right, 0.5 centre; negative means no reverb. */
+    static float getPan(juce::AudioChannelSet::ChannelType type) noexcept
+    {
+        using Set = juce::AudioChannelSet;
+
+        switch (type)
+        {
+            case Set::left:
+            case Set::leftCentre:
+            case Set::leftSurround:
+            case Set::leftSurroundSide:
+            case Set::leftSurroundRear:
+            case Set::wideLeft:
+            case Set::topFrontLeft:
+            case Set::topSideLeft:
+            case Set::topRearLeft:
+                return 0.0f;
+
+            case Set::right:
+            case Set::rightCentre:
+            case Set::rightSurround:
+            case Set::rightSurroundSide:
+            case Set::rightSurroundRear:
+            case Set::wideRight:
+            case Set::topFrontRight:
+            case Set::topSideRight:
+            case Set::topRearRight:
+                return 1.0f;
+
+            case Set::LFE:
+            case Set::LFE2:
+                return -1.0f;
+
+            default:
+                return 0.5f;
+        }
+    }
+
+    /** Constant-power gains into the L/R send for a channel. */
+    static void getSendGains(juce::AudioChannelSet::ChannelType type, float& toLeft, float& toRight) noexcept
+    {
+        const auto pan = getPan(type);
+
+        if (pan < 0.0f)
+        {
+            toLeft = toRight = 0.0f;
+            return;
+        }
+
+        toLeft = std::cos(pan * juce::MathConstants<float>::halfPi);
+        toRight = std::sin(pan * juce::MathConstants<float>::halfPi);
+
+        // Snap the hard-panned gains so a plain L/R pair stays bit exact
+        if (std::abs(toLeft) < 1.0e-6f)  toLeft = 0.0f;
+        if (std::abs(toRight) < 1.0e-6f) toRight = 0.0f;
+    }
+};
+
+//==============================================================================
+template <typename SampleType>
+class SurroundSend
+{
+public:
+    SurroundSend() = default;
+
+    void prepare(const juce::AudioChannelSet& layout)
+    {
+        numChannels = juce::jmin(layout.size(), SurroundLayout::maxChannels);
+        lfeChannel = layout.getChannelIndexForType(juce::AudioChannelSet::LFE);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float l, r;
+            SurroundLayout::getSendGains(layout.getTypeOfChannel(channel), l, r);
+            gainL[(size_t) channel] = static_cast<SampleType>(l);
+            gainR[(size_t) channel] = static_cast<SampleType>(r);
+        }
+    }
+
+    /** Index of the LFE channel, which is left dry, or -1. */
+    int getLfeChannel() const noexcept { return lfeChannel; }
+
+    /** Sums input into the two channels of send. */
+    void process(const juce::dsp::AudioBlock<const SampleType>& input, juce::dsp::AudioBlock<SampleType>& send) const noexcept
+    {
+        const auto numSamples = (int) send.getNumSamples();
+        auto* left = send.getChannelPointer(0);
+        auto* right = send.getChannelPointer(1);
+
+        juce::FloatVectorOperations::clear(left, numSamples);
+        juce::FloatVectorOperations::clear(right, numSamples);
+
+        for (int channel = 0; channel < juce::jmin(numChannels, (int) input.getNumChannels()); ++channel)
+        {
+            const auto* source = input.getChannelPointer((size_t) channel);
+
+            if (gainL[(size_t) channel] != SampleType(0))
+                juce::FloatVectorOperations::addWithMultiply(left, source, gainL[(size_t) channel], numSamples);
+
+            if (gainR[(size_t) channel] != SampleType(0))
+                juce::FloatVectorOperations::addWithMultiply(right, source, gainR[(size_t) channel], numSamples);
+        }
+    }
+
+private:
+    int numChannels = 0;
+    int lfeChannel = -1;
+    std::array<SampleType, SurroundLayout::maxChannels> gainL {}, gainR {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SurroundSend)
+};
+
+//==============================================================================
+template <typename SampleType>
+class SurroundSpreader
+{
+public:
+    SurroundSpreader() = default;
+
+    /** Channels 0 and 1 of the layout are the stereo source; the rest are derived. */
+    void prepare(const juce::dsp::ProcessSpec& spec, const juce::AudioChannelSet& layout)
+    {
+        numExtra = juce::jlimit(0, maxExtra, (int) spec.numChannels - 2);
+        activeVecs = ((size_t) numExtra + lanes - 1) / lanes;
+
+        alignas(Vec) SampleType l[stride] = {}, r[stride] = {};
+        int longest = 1;
+
+        for (int e = 0; e < numExtra; ++e)
+        {
+            const auto type = e + 2 < layout.size() ? layout.getTypeOfChannel(e + 2)
+                                                    : juce::AudioChannelSet::centre;
+            float toLeft, toRight;
+            SurroundLayout::getSendGains(type, toLeft, toRight);
+            l[e] = static_cast<SampleType>(toLeft);
+            r[e] = static_cast<SampleType>(toRight);
+
+            // Golden-ratio steps spread the lengths over one octave per stage
+            const auto spread = 1.0 + std::fmod(0.6180339887 * (e + 1), 1.0);
+
+            for (int s = 0; s < numStages; ++s)
+            {
+                const auto length = juce::jmax(1, juce::roundToInt(stageMs[s] * spread * 0.001 * spec.sampleRate));
+                lengths[(size_t) s][(size_t) e] = length;
+                longest = juce::jmax(longest, length);
+            }
+        }
+
+        for (size_t v = 0; v < numVecs; ++v)
+        {
+            fromLeft[v] = Vec::fromRawArray(l + v * lanes);
+            fromRight[v] = Vec::fromRawArray(r + v * lanes);
+        }
+
+        const auto rows = juce::nextPowerOfTwo(longest + 1);
+        mask = rows - 1;
+        storage.allocate((size_t) (numStages * rows) * stride + lanes, true);
+        rings = Vec::getNextSIMDAlignedPtr(storage.get());
+        ringSize = (size_t) rows * stride;
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (rings != nullptr)
+            std::fill(rings, rings + ringSize * numStages, SampleType(0));
+
+        writePos = 0;
+    }
+
+    /** Reads channels 0 and 1 of block and writes the derived channels after them. */
+    void process(juce::dsp::AudioBlock<SampleType>& block) noexcept
+    {
+        const auto numOutputs = juce::jmin(numExtra, (int) block.getNumChannels() - 2);
+
+        if (numOutputs <= 0)
+            return;
+
+        const auto* inL = block.getChannelPointer(0);
+        const auto* inR = block.getChannelPointer(1);
+        SampleType* outputs[maxExtra] = {};
+
+        for (int e = 0; e < numOutputs; ++e)
+            outputs[e] = block.getChannelPointer((size_t) e + 2);
+
+        const auto g = Vec::expand(allpassGain);
+
+        for (size_t i = 0; i < block.getNumSamples(); ++i)
+        {
+            Vec x[numVecs];
+
+            for (size_t v = 0; v < activeVecs; ++v)
+                x[v] = fromLeft[v] * inL[i] + fromRight[v] * inR[i];
+
+            for (int s = 0; s < numStages; ++s)
+            {
+                auto* ring = rings + (size_t) s * ringSize;
+
+                for (int e = 0; e < numExtra; ++e)
+                    delayed[e] = ring[(size_t) ((writePos - lengths[(size_t) s][(size_t) e]) & mask) * stride + (size_t) e];
+
+                auto* row = ring + (size_t) writePos * stride;
+
+                for (size_t v = 0; v < activeVecs; ++v)
+                {
+                    const auto d = Vec::fromRawArray(delayed + v * lanes);
+                    const auto w = x[v] + g * d;
+                    w.copyToRawArray(row + v * lanes);
+                    x[v] = d - g * w;
+                }
+            }
+
+            for (size_t v = 0; v < activeVecs; ++v)
+                x[v].copyToRawArray(delayed + v * lanes);
+
+            for (int e = 0; e < numOutputs; ++e)
+                outputs[e][i] = delayed[e];
+
+            writePos = (writePos + 1) & mask;
+        }
+    }
+
+private:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+    static constexpr int maxExtra = SurroundLayout::maxChannels - 2;
+    static constexpr size_t lanes = Vec::size();
+    static constexpr size_t numVecs = ((size_t) maxExtra + lanes - 1) / lanes;
+    static constexpr size_t stride = numVecs * lanes;
+    static constexpr int numStages = 3;
+    static constexpr double stageMs[numStages] = { 3.1, 7.3, 13.7 };
+    static constexpr SampleType allpassGain = SampleType(0.5);
+
+    int numExtra = 0;
+    size_t activeVecs = 0;
+    Vec fromLeft[numVecs], fromRight[numVecs];
+    std::array<std::array<int, stride>, numStages> lengths {};
+    alignas(Vec) SampleType delayed[stride] = {};
+
+    juce::HeapBlock<SampleType> storage;
+    SampleType* rings = nullptr;
+    size_t ringSize = 0;
+    int mask = 0;
+    int writePos = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SurroundSpreader)
+};
@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    Telemetry.h
+
+    Levels and a wet signal feed from the audio thread to the editor.
+
+    SpscQueue is a wait-free single-producer/single-consumer ring. The audio
+    thread pushes, the message thread pops, and neither side ever waits: a
+    full queue drops whatever doesn't fit.
+
+    Telemetry gathers peak and RMS for the input, wet and output stages into
+    frames of about 10 ms, plus a mono copy of the wet signal, decimated to
+    48 kHz or below, for the spectrum. Nothing is measured unless an editor
+    has switched it on.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename Item, int capacity>
+class SpscQueue
+{
+public:
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    SpscQueue() = default;
+
+    /** Producer: copies in as many items as fit and returns how many. */
+    int push(const Item* source, int numItems) noexcept
+    {
+        const auto write = writePos.load(std::memory_order_relaxed);
+        const auto read = readPos.load(std::memory_order_acquire);
+        const auto count = juce::jmin(numItems, capacity - (int) (write - read));
+
+        for (int i = 0; i < count; ++i)
+            items[(write + (juce::uint32) i) & mask] = source[i];
+
+        writePos.store(write + (juce::uint32) count, std::memory_order_release);
+        return count;
+    }
+
+    /** Consumer: copies out up to maxItems, oldest first, and returns how many. */
+    int pop(Item* destination, int maxItems) noexcept
+    {
+        const auto read = readPos.load(std::memory_order_relaxed);
+        const auto write = writePos.load(std::memory_order_acquire);
+        const auto count = juce::jmin(maxItems, (int) (write - read));
+
+        for (int i = 0; i < count; ++i)
+            destination[i] = items[(read + (juce::uint32) i) & mask];
+
+        readPos.store(read + (juce::uint32) count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    // Positions only ever count up; unsigned wrap-around keeps write - read right
+    static constexpr juce::uint32 mask = (juce::uint32) capacity - 1;
+
+    std::array<Item, (size_t) capacity> items {};
+    std::atomic<juce::uint32> readPos { 0 };
+    std::atomic<juce::uint32> writePos { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpscQueue)
+};
+
+//==============================================================================
+class Telemetry
+{
+public:
+    enum Stage
+    {
+        input,
+        wet,
+        output,
+        numStages
+    };
+
+    struct LevelFrame
+    {
+        std::array<float, numStages> peak {};
+        std::array<float, numStages> rms {};
+    };
+
+    Telemetry() = default;
+
+    /** Message thread: the editor switches measuring on while it is open. */
+    void setEnabled(bool shouldBeEnabled) noexcept { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+
+    /** From prepareToPlay. */
+    void prepare(double sampleRate) noexcept
+    {
+        frameLength = juce::jmax(1, juce::roundToInt(sampleRate * frameSeconds));
+        decimation = juce::jmax(1, (int) std::ceil(sampleRate / maxStreamRate - 1.0e-6));
+        streamSampleRate.store(sampleRate / decimation, std::memory_order_relaxed);
+        clear();
+    }
+
+    /** Audio thread, at the start of every block. Returns false, and the
+        other calls do nothing, while no editor is listening.
+    */
+    bool beginBlock() noexcept
+    {
+        const auto shouldMeasure = enabled.load(std::memory_order_relaxed);
+
+        // Don't let a half-built frame from the last session through
+        if (shouldMeasure && ! active)
+            clear();
+
+        active = shouldMeasure;
+        return active;
+    }
+
+    /** Audio thread: adds a stretch of one stage's signal to the frame. */
+    template <typename SampleType>
+    void addLevels(Stage stage, const juce::AudioBuffer<SampleType>& buffer, int startSample, int numSamples, int numChannels) noexcept
+    {
+        if (! active || numSamples <= 0)
+            return;
+
+        auto& accumulator = accumulators[(size_t) stage];
+        numChannels = juce::jmin(numChannels, buffer.getNumChannels());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto* data = buffer.getReadPointer(channel, startSample);
+            float peak = accumulator.peak;
+            double sumSquares = 0.0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                peak = juce::jmax(peak, (float) std::abs(data[i]));
+                sumSquares += (double) data[i] * (double) data[i];
+            }
+
+            accumulator.peak = peak;
+            accumulator.sumSquares += sumSquares;
+            accumulator.numValues += numSamples;
+        }
+    }
+
+    /** Audio thread: feeds the spectrum with the mid of the wet signal.
+        right may be nullptr for mono.
+    */
+    template <typename SampleType>
+    void addWetStream(const SampleType* left, const SampleType* right, int numSamples) noexcept
+    {
+        if (! active)
+            return;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            decimationSum += (float) (right != nullptr ? SampleType(0.5) * (left[i] + right[i]) : left[i]);
+
+            if (++decimationCount < decimation)
+                continue;
+
+            streamScratch[(size_t) scratchFill++] = decimationSum / (float) decimation;
+            decimationSum = 0.0f;
+            decimationCount = 0;
+
+            if (scratchFill == (int) streamScratch.size())
+            {
+                stream.push(streamScratch.data(), scratchFill);
+                scratchFill = 0;
+            }
+        }
+    }
+
+    /** Audio thread, at the end of every block: publishes finished frames. */
+    void endBlock(int numSamples) noexcept
+    {
+        if (! active)
+            return;
+
+        frameSamples += numSamples;
+
+        if (frameSamples < frameLength)
+            return;
+
+        LevelFrame frame;
+
+        for (size_t stage = 0; stage < accumulators.size(); ++stage)
+        {
+            auto& accumulator = accumulators[stage];
+            frame.peak[stage] = accumulator.peak;
+            frame.rms[stage] = accumulator.numValues > 0 ? (float) std::sqrt(accumulator.sumSquares / accumulator.numValues) : 0.0f;
+            accumulator = {};
+        }
+
+        levels.push(&frame, 1);
+        frameSamples = 0;
+    }
+
+    // Message thread
+    int popLevels(LevelFrame* destination, int maxFrames) noexcept     { return levels.pop(destination, maxFrames); }
+    int popWetStream(float* destination, int maxSamples) noexcept       { return stream.pop(destination, maxSamples); }
+    double getStreamSampleRate() const noexcept                         { return streamSampleRate.load(std::memory_order_relaxed); }
+
+private:
+    void clear() noexcept
+    {
+        accumulators = {};
+        frameSamples = 0;
+        decimationSum = 0.0f;
+        decimationCount = 0;
+        scratchFill = 0;
+    }
+
+    static constexpr double frameSeconds = 0.01;
+    static constexpr double maxStreamRate = 48000.0;
+
+    std::atomic<bool> enabled { false };
+    bool active = false;
+
+    struct Accumulator
+    {
+        float peak = 0.0f;
+        double sumSquares = 0.0;
+        int numValues = 0;
+    };
+
+    std::array<Accumulator, numStages> accumulators {};
+    int frameLength = 441;
+    int frameSamples = 0;
+
+    // Wet stream, mixed to mono and averaged down by the decimation factor
+    int decimation = 1;
+    int decimationCount = 0;
+    float decimationSum = 0.0f;
+    std::array<float, 256> streamScratch {};
+    int scratchFill = 0;
+    std::atomic<double> streamSampleRate { 44100.0 };
+
+    SpscQueue<LevelFrame, 128> levels;
+    SpscQueue<float, (1 << 14)> stream;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Telemetry)
+};
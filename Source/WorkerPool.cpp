@@ -0,0 +1,216 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+#include "RealtimeSafetyChecker.h"
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+ #pragma comment (lib, "Synchronization.lib")
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr int spinsBeforeSleep = 4000;
+    constexpr int maxWorkers = 3;
+
+    inline void cpuRelax() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (defined (__GNUC__) || defined (__clang__))
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    // Sleeps while word == expected; spurious returns are fine
+    void waitOnWord(std::atomic<juce::uint32>& word, juce::uint32 expected) noexcept
+    {
+       #if JUCE_LINUX
+        syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+       #elif JUCE_WINDOWS
+        WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+       #else
+        // No portable address wait: poll. The audio thread never waits for
+        // a sleeping worker, so this only costs parallelism, not deadlines.
+        if (word.load(std::memory_order_acquire) == expected)
+            juce::Thread::sleep(1);
+       #endif
+    }
+
+    void wakeAllOnWord(std::atomic<juce::uint32>& word) noexcept
+    {
+       #if JUCE_LINUX
+        syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+       #elif JUCE_WINDOWS
+        WakeByAddressAll(&word);
+       #else
+        juce::ignoreUnused(word);
+       #endif
+    }
+
+    constexpr juce::uint64 makeTicket(juce::uint64 generation, int numJobs, int index) noexcept
+    {
+        return (generation << 32) | ((juce::uint64) numJobs << 16) | (juce::uint64) index;
+    }
+}
+
+//==============================================================================
+class WorkerPool::Worker : public juce::Thread
+{
+public:
+    Worker(WorkerPool& p, int i)
+        : juce::Thread("IKReverb worker " + juce::String(i + 1)), pool(p), index(i)
+    {
+    }
+
+    void run() override
+    {
+        // Keep off core 0, which hosts tend to give their own audio thread
+        const auto numCpus = juce::jmax(1, juce::SystemStats::getNumCpus());
+        juce::Thread::setCurrentThreadAffinityMask((juce::uint32) 1 << ((index + 1) % juce::jmin(numCpus, 32)));
+
+        pool.workerLoop();
+    }
+
+private:
+    WorkerPool& pool;
+    const int index;
+};
+
+//==============================================================================
+WorkerPool::WorkerPool()
+{
+    const auto numWorkers = juce::jlimit(0, maxWorkers, juce::SystemStats::getNumPhysicalCpus() - 1);
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto worker = std::make_unique<Worker>(*this, i);
+
+        if (! worker->startRealtimeThread(juce::Thread::RealtimeOptions{}))
+            worker->startThread(juce::Thread::Priority::highest);
+
+        workers.push_back(std::move(worker));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    exiting.store(true);
+    wakeCounter.fetch_add(1);
+    wakeAllOnWord(wakeCounter);
+
+    for (auto& worker : workers)
+        worker->stopThread(2000);
+}
+
+//==============================================================================
+void WorkerPool::run(Job job, void* context, int numJobs) noexcept
+{
+    jassert(numJobs <= maxJobs);
+
+    if (numJobs <= 1 || workers.empty() || inUse.exchange(true, std::memory_order_acquire))
+    {
+        runInline(job, context, numJobs);
+        return;
+    }
+
+    currentJob = job;
+    currentContext = context;
+    remaining.store(numJobs, std::memory_order_relaxed);
+
+    const auto generation = (ticket.load(std::memory_order_relaxed) >> 32) + 1;
+    ticket.store(makeTicket(generation, numJobs, 0), std::memory_order_release);
+
+    // Pairs with the sleeper count in workerLoop(), so a worker about to
+    // sleep either sees the new counter or is seen here and woken
+    wakeCounter.fetch_add(1);
+
+    if (numSleeping.load() > 0)
+        wakeAllOnWord(wakeCounter);
+
+    while (claimAndRun())
+    {
+    }
+
+    while (remaining.load(std::memory_order_acquire) > 0)
+        cpuRelax();
+
+    inUse.store(false, std::memory_order_release);
+}
+
+void WorkerPool::runInline(Job job, void* context, int numJobs) noexcept
+{
+    for (int i = 0; i < numJobs; ++i)
+        job(context, i);
+}
+
+bool WorkerPool::claimAndRun() noexcept
+{
+    auto current = ticket.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto numJobs = (int) ((current >> 16) & 0xffff);
+        const auto index = (int) (current & 0xffff);
+
+        if (index >= numJobs)
+            return false;
+
+        if (ticket.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            // The claim holds remaining above zero, so the job fields can't
+            // change until this job has finished
+            {
+                // A job is part of processBlock on whichever thread runs it
+                RealtimeSafetyChecker::ScopedAudioThread realtimeCheck;
+                currentJob(currentContext, index);
+            }
+
+            remaining.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    auto seen = wakeCounter.load();
+
+    while (! exiting.load(std::memory_order_relaxed))
+    {
+        while (claimAndRun())
+        {
+        }
+
+        bool woken = false;
+
+        for (int i = 0; i < spinsBeforeSleep && ! woken; ++i)
+        {
+            cpuRelax();
+            woken = wakeCounter.load(std::memory_order_acquire) != seen;
+        }
+
+        if (! woken)
+        {
+            numSleeping.fetch_add(1);
+            waitOnWord(wakeCounter, seen);
+            numSleeping.fetch_sub(1);
+        }
+
+        seen = wakeCounter.load();
+    }
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+    A few real-time worker threads, shared by every plugin instance in the
+    process, that help the audio thread through one block's independent
+    jobs.
+
+    run() publishes a job function, wakes the workers and then works through
+    the job indices itself alongside them. Indices are claimed from a single
+    atomic ticket, so a worker that is slow to wake just finds nothing left
+    to do, and the audio thread never waits for a worker that hasn't started.
+    The only wait is the spin at the end, for jobs a worker is already
+    running. Nothing on that path allocates or locks. Idle workers spin
+    briefly and then sleep on a futex (WaitOnAddress on Windows, a short
+    sleep elsewhere).
+
+    Only one run() can use the workers at a time. If another instance holds
+    them, the jobs simply run inline on the calling thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class WorkerPool
+{
+public:
+    using Job = void (*)(void* context, int index);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    /** Audio thread: calls job(context, i) for every i in [0, numJobs) and
+        returns once all of them have finished. Jobs must not depend on
+        each other.
+    */
+    void run(Job job, void* context, int numJobs) noexcept;
+
+private:
+    class Worker;
+
+    void workerLoop();
+    bool claimAndRun() noexcept;
+    static void runInline(Job job, void* context, int numJobs) noexcept;
+
+    // Ticket layout: generation in the top 32 bits, job count in the next
+    // 16 and the next unclaimed index in the low 16
+    static constexpr int maxJobs = 0xffff;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<juce::uint64> ticket { 0 };
+    std::atomic<int> remaining { 0 };
+    std::atomic<juce::uint32> wakeCounter { 0 };   // Futex word
+    std::atomic<int> numSleeping { 0 };
+    std::atomic<bool> inUse { false };
+    std::atomic<bool> exiting { false };
+
+    // Written before the ticket is published, read after a successful claim
+    Job currentJob = nullptr;
+    void* currentContext = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkerPool)
+};
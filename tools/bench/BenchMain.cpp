@@ -0,0 +1,488 @@
+/*
+  ==============================================================================
+
+    BenchMain.cpp
+
+    Offline processBlock benchmark. Drives IKReverbAudioProcessor over a
+    matrix of block sizes, sample rates, reverb types and modulation on/off,
+    and prints per-configuration timings as JSON, along with the per-block
+    cost of reading the parameters. --eco runs every configuration with the
+    ECO quality setting, --layout runs a surround bed instead of stereo,
+    and --multi turns on the MULTI threading mode.
+
+    --precision=double runs the native double-precision processBlock, and
+    --precision=converted times what a 64-bit host has to do for a
+    float-only plugin: copy each block to float and back around the call.
+
+    --editor also opens the editor on the desktop for a while (10 s unless
+    given) as a thread feeds the processor in real time, and reports how
+    often it painted and what share of a core painting took. It needs a
+    display.
+
+    Usage:
+      ikreverb_bench [--quick] [--eco] [--multi] [--seconds=<s>] [--output=<file.json>]
+                     [--block-sizes=16,64,...] [--sample-rates=44100,...]
+                     [--types=0,1,...] [--layout=stereo|5.1|7.1|7.1.4]
+                     [--precision=float|double|converted] [--editor[=<s>]]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+#include "RealtimeSafetyChecker.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    struct BenchConfig
+    {
+        int blockSize;
+        double sampleRate;
+        int type;
+        bool modulation;
+    };
+
+    struct BenchSettings
+    {
+        juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+        juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+        juce::Array<int> types;
+        double secondsPerConfig = 2.0;
+        double warmupSeconds = 0.25;
+        bool eco = false;
+        bool multi = false;
+        juce::String precision = "float";
+        juce::AudioChannelSet layout = juce::AudioChannelSet::stereo();
+        juce::String layoutName = "stereo";
+    };
+
+    bool parseLayout (const juce::String& name, juce::AudioChannelSet& layout)
+    {
+        if (name == "mono")        layout = juce::AudioChannelSet::mono();
+        else if (name == "stereo") layout = juce::AudioChannelSet::stereo();
+        else if (name == "5.1")    layout = juce::AudioChannelSet::create5point1();
+        else if (name == "7.1")    layout = juce::AudioChannelSet::create7point1();
+        else if (name == "7.1.4")  layout = juce::AudioChannelSet::create7point1point4();
+        else                       return false;
+
+        return true;
+    }
+
+    void setParameter (IKReverbAudioProcessor& processor, const juce::String& id, float value)
+    {
+        if (auto* param = processor.getAPVTS().getParameter (id))
+            param->setValueNotifyingHost (param->convertTo0to1 (value));
+    }
+
+    double percentile (const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        auto index = juce::jlimit ((size_t) 0, sorted.size() - 1,
+                                   (size_t) std::ceil (p * (double) sorted.size()) - 1);
+        return sorted[index];
+    }
+
+    juce::var runConfig (const BenchConfig& config, const BenchSettings& settings,
+                         const juce::StringArray& typeNames)
+    {
+        IKReverbAudioProcessor processor;
+        const int numChannels = settings.layout.size();
+
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add (settings.layout);
+        buses.outputBuses.add (settings.layout);
+        processor.setBusesLayout (buses);
+        processor.setRateAndBufferSizeDetails (config.sampleRate, config.blockSize);
+
+        setParameter (processor, "type", (float) config.type);
+        setParameter (processor, "modulation", config.modulation ? 0.5f : 0.0f);
+        setParameter (processor, "predelay", 20.0f);
+        setParameter (processor, "lowcut", 80.0f);
+        setParameter (processor, "highcut", 12000.0f);
+        setParameter (processor, "quality", settings.eco ? 1.0f : 0.0f);
+        setParameter (processor, "threading", settings.multi ? 1.0f : 0.0f);
+
+        const auto hostIsDouble = settings.precision != "float";
+        const auto nativeDouble = settings.precision == "double";
+
+        if (nativeDouble)
+            processor.setProcessingPrecision (juce::AudioProcessor::doublePrecision);
+
+        processor.prepareToPlay (config.sampleRate, config.blockSize);
+
+        // One second of noise bursts is enough source material; blocks loop over it
+        const int sourceLength = (int) config.sampleRate;
+        juce::AudioBuffer<float> source (numChannels, sourceLength);
+        juce::Random random (0x1cebu);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = source.getWritePointer (channel);
+
+            for (int i = 0; i < sourceLength; ++i)
+                data[i] = (i % 24000) < 4800 ? (random.nextFloat() * 2.0f - 1.0f) * 0.5f : 0.0f;
+        }
+
+        juce::AudioBuffer<float> io (numChannels, config.blockSize);
+        juce::AudioBuffer<double> hostIO (numChannels, config.blockSize);
+        juce::MidiBuffer midi;
+        int sourcePos = 0;
+
+        auto processOneBlock = [&]
+        {
+            for (int done = 0; done < config.blockSize;)
+            {
+                auto num = juce::jmin (config.blockSize - done, sourceLength - sourcePos);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    io.copyFrom (channel, done, source, channel, sourcePos, num);
+
+                done += num;
+                sourcePos = (sourcePos + num) % sourceLength;
+            }
+
+            // A double host's own buffer; filling it isn't part of the timing
+            if (hostIsDouble)
+                hostIO.makeCopyOf (io, true);
+
+            const auto start = std::chrono::steady_clock::now();
+
+            if (nativeDouble)
+            {
+                processor.processBlock (hostIO, midi);
+            }
+            else if (hostIsDouble)
+            {
+                io.makeCopyOf (hostIO, true);
+                processor.processBlock (io, midi);
+                hostIO.makeCopyOf (io, true);
+            }
+            else
+            {
+                processor.processBlock (io, midi);
+            }
+
+            const auto end = std::chrono::steady_clock::now();
+
+            return (double) std::chrono::duration_cast<std::chrono::nanoseconds> (end - start).count();
+        };
+
+        const int warmupBlocks = juce::jmax (1, (int) std::ceil (settings.warmupSeconds * config.sampleRate / config.blockSize));
+        const int timedBlocks  = juce::jmax (8, (int) std::ceil (settings.secondsPerConfig * config.sampleRate / config.blockSize));
+
+        for (int i = 0; i < warmupBlocks; ++i)
+            processOneBlock();
+
+        RealtimeSafetyChecker::resetViolations();
+
+        std::vector<double> blockNanos;
+        blockNanos.reserve ((size_t) timedBlocks);
+
+        for (int i = 0; i < timedBlocks; ++i)
+            blockNanos.push_back (processOneBlock());
+
+        const auto violations = RealtimeSafetyChecker::getNumViolations();
+        processor.releaseResources();
+
+        double totalNanos = 0.0;
+        for (auto ns : blockNanos)
+            totalNanos += ns;
+
+        std::sort (blockNanos.begin(), blockNanos.end());
+
+        const auto totalSamples = (double) timedBlocks * config.blockSize;
+        const auto audioSeconds = totalSamples / config.sampleRate;
+        const auto blockDeadlineNanos = 1.0e9 * config.blockSize / config.sampleRate;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("block_size", config.blockSize);
+        result->setProperty ("sample_rate", config.sampleRate);
+        result->setProperty ("latency_samples", processor.getLatencySamples());
+        result->setProperty ("type", config.type);
+        result->setProperty ("type_name", typeNames[config.type]);
+        result->setProperty ("modulation", config.modulation);
+        result->setProperty ("blocks", timedBlocks);
+        result->setProperty ("ns_per_sample", totalNanos / totalSamples);
+        result->setProperty ("realtime_factor", audioSeconds / (totalNanos * 1.0e-9));
+
+        auto* latency = new juce::DynamicObject();
+        latency->setProperty ("p50", percentile (blockNanos, 0.50));
+        latency->setProperty ("p90", percentile (blockNanos, 0.90));
+        latency->setProperty ("p99", percentile (blockNanos, 0.99));
+        latency->setProperty ("p999", percentile (blockNanos, 0.999));
+        latency->setProperty ("max", blockNanos.back());
+        result->setProperty ("block_ns", juce::var (latency));
+
+        // Worst-case share of the real-time deadline one block used up
+        result->setProperty ("deadline_load_p99", percentile (blockNanos, 0.99) / blockDeadlineNanos);
+        result->setProperty ("deadline_load_max", blockNanos.back() / blockDeadlineNanos);
+        result->setProperty ("rt_violations", violations);
+
+        return juce::var (result);
+    }
+
+    // Per-block cost of reading every parameter: by name, the way
+    // processBlock used to, against the snapshot of cached handles
+    juce::var runParameterOverhead()
+    {
+        IKReverbAudioProcessor processor;
+        auto& apvts = processor.getAPVTS();
+        const char* const ids[] = { "size", "damping", "mix", "type", "interval", "predelay",
+                                    "modulation", "lowcut", "highcut", "quality", "threading", "freeze" };
+        constexpr int iterations = 200000;
+        volatile float sink = 0.0f;
+
+        auto nanosPerBlock = [&] (auto&& readParameters)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < iterations; ++i)
+                sink = sink + readParameters();
+
+            const auto end = std::chrono::steady_clock::now();
+            return (double) std::chrono::duration_cast<std::chrono::nanoseconds> (end - start).count() / iterations;
+        };
+
+        const auto lookupNanos = nanosPerBlock ([&]
+        {
+            float sum = 0.0f;
+
+            for (auto* id : ids)
+                sum += apvts.getRawParameterValue (id)->load();
+
+            return sum;
+        });
+
+        const auto snapshotNanos = nanosPerBlock ([&]
+        {
+            const auto snapshot = processor.getParameterSnapshot();
+            return snapshot.size + snapshot.damping + snapshot.mix + snapshot.predelayMs + snapshot.modulation
+                 + snapshot.lowCut + snapshot.highCut + (float) (snapshot.type + snapshot.interval)
+                 + (snapshot.eco ? 1.0f : 0.0f) + (snapshot.multiThreaded ? 1.0f : 0.0f) + (snapshot.freeze ? 1.0f : 0.0f);
+        });
+
+        std::cerr << "Parameters per block: " << lookupNanos << " ns by name, "
+                  << snapshotNanos << " ns from the snapshot" << std::endl;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("lookup_ns_per_block", lookupNanos);
+        result->setProperty ("snapshot_ns_per_block", snapshotNanos);
+        return juce::var (result);
+    }
+
+    // What an open editor costs the message thread, with the meters moving
+    juce::var runEditor (double seconds)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int blockSize = 512;
+
+        IKReverbAudioProcessor processor;
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        std::atomic<bool> stop { false };
+
+        std::thread audio ([&]
+        {
+            juce::AudioBuffer<float> io (2, blockSize);
+            juce::MidiBuffer midi;
+            juce::Random random (0x1cebu);
+            auto next = std::chrono::steady_clock::now();
+
+            // The same noise bursts as runConfig, paced like a device
+            for (int pos = 0; ! stop.load(); pos = (pos + blockSize) % 24000)
+            {
+                for (int channel = 0; channel < 2; ++channel)
+                    for (int i = 0; i < blockSize; ++i)
+                        io.setSample (channel, i, (pos + i) % 24000 < 4800 ? (random.nextFloat() * 2.0f - 1.0f) * 0.5f : 0.0f);
+
+                processor.processBlock (io, midi);
+
+                next += std::chrono::microseconds ((juce::int64) (1.0e6 * blockSize / sampleRate));
+                std::this_thread::sleep_until (next);
+            }
+        });
+
+        std::unique_ptr<juce::AudioProcessorEditor> editor (processor.createEditorIfNeeded());
+        editor->addToDesktop (juce::ComponentPeer::windowHasTitleBar);
+        editor->setVisible (true);
+
+        juce::Timer::callAfterDelay ((int) (seconds * 1000.0), [] { juce::MessageManager::getInstance()->stopDispatchLoop(); });
+        juce::MessageManager::getInstance()->runDispatchLoop();
+
+        const auto stats = static_cast<IKReverbAudioProcessorEditor&> (*editor).getPaintStats();
+        editor.reset();
+
+        stop = true;
+        audio.join();
+        processor.releaseResources();
+
+        const auto openSeconds = juce::jmax (1.0e-9, stats.openSeconds);
+
+        std::cerr << "Editor: " << stats.numPaints << " paints in " << stats.openSeconds << " s, "
+                  << stats.paintSeconds / openSeconds * 100.0 << "% of a core" << std::endl;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("open_seconds", stats.openSeconds);
+        result->setProperty ("paints", stats.numPaints);
+        result->setProperty ("paints_per_second", stats.numPaints / openSeconds);
+        result->setProperty ("paint_seconds", stats.paintSeconds);
+        result->setProperty ("core_load", stats.paintSeconds / openSeconds);
+        return juce::var (result);
+    }
+
+    template <typename ValueType>
+    juce::Array<ValueType> parseList (const juce::String& text)
+    {
+        juce::Array<ValueType> values;
+
+        for (auto& token : juce::StringArray::fromTokens (text, ",", {}))
+            if (token.trim().isNotEmpty())
+                values.add ((ValueType) token.trim().getDoubleValue());
+
+        return values;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    BenchSettings settings;
+    juce::StringArray typeNames;
+
+    {
+        IKReverbAudioProcessor probe;
+
+        if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (probe.getAPVTS().getParameter ("type")))
+            typeNames = choice->choices;
+    }
+
+    for (int i = 0; i < typeNames.size(); ++i)
+        settings.types.add (i);
+
+    if (args.containsOption ("--quick"))
+    {
+        settings.blockSizes = { 64, 512 };
+        settings.sampleRates = { 48000.0, 96000.0 };
+        settings.secondsPerConfig = 0.5;
+    }
+
+    settings.eco = args.containsOption ("--eco");
+    settings.multi = args.containsOption ("--multi");
+
+    if (args.containsOption ("--precision"))
+    {
+        settings.precision = args.getValueForOption ("--precision");
+
+        if (settings.precision != "float" && settings.precision != "double" && settings.precision != "converted")
+        {
+            std::cerr << "Unknown precision: " << settings.precision << std::endl;
+            return 1;
+        }
+    }
+
+    if (args.containsOption ("--layout"))
+    {
+        settings.layoutName = args.getValueForOption ("--layout");
+
+        if (! parseLayout (settings.layoutName, settings.layout))
+        {
+            std::cerr << "Unknown layout: " << settings.layoutName << std::endl;
+            return 1;
+        }
+    }
+
+    if (args.containsOption ("--seconds"))
+        settings.secondsPerConfig = juce::jmax (0.01, args.getValueForOption ("--seconds").getDoubleValue());
+
+    if (args.containsOption ("--block-sizes"))
+        settings.blockSizes = parseList<int> (args.getValueForOption ("--block-sizes"));
+
+    if (args.containsOption ("--sample-rates"))
+        settings.sampleRates = parseList<double> (args.getValueForOption ("--sample-rates"));
+
+    if (args.containsOption ("--types"))
+        settings.types = parseList<int> (args.getValueForOption ("--types"));
+
+    const auto measureEditor = args.containsOption ("--editor");
+    auto editorSeconds = 10.0;
+
+    if (measureEditor)
+    {
+        if (args.getValueForOption ("--editor").isNotEmpty())
+            editorSeconds = juce::jmax (1.0, args.getValueForOption ("--editor").getDoubleValue());
+
+        if (juce::Desktop::getInstance().getDisplays().getPrimaryDisplay() == nullptr)
+        {
+            std::cerr << "--editor needs a display" << std::endl;
+            return 1;
+        }
+    }
+
+    RealtimeSafetyChecker::setMode (RealtimeSafetyChecker::Mode::countViolations);
+
+    juce::Array<juce::var> results;
+
+    for (auto sampleRate : settings.sampleRates)
+    {
+        for (auto blockSize : settings.blockSizes)
+        {
+            for (auto type : settings.types)
+            {
+                if (! juce::isPositiveAndBelow (type, typeNames.size()))
+                    continue;
+
+                for (auto modulation : { false, true })
+                {
+                    BenchConfig config { blockSize, sampleRate, type, modulation };
+                    auto result = runConfig (config, settings, typeNames);
+                    results.add (result);
+
+                    std::cerr << typeNames[type] << " " << sampleRate << " Hz, " << blockSize
+                              << " samples, mod " << (modulation ? "on" : "off") << ": "
+                              << (double) result["ns_per_sample"] << " ns/sample" << std::endl;
+                }
+            }
+        }
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty ("benchmark", "ikreverb_bench");
+    report->setProperty ("juce_version", juce::SystemStats::getJUCEVersion());
+    report->setProperty ("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty ("num_cpus", juce::SystemStats::getNumCpus());
+    report->setProperty ("timestamp", juce::Time::getCurrentTime().toISO8601 (true));
+    report->setProperty ("rt_checks", IKREVERB_RT_CHECKS != 0);
+    report->setProperty ("seconds_per_config", settings.secondsPerConfig);
+    report->setProperty ("quality", settings.eco ? "eco" : "high");
+    report->setProperty ("layout", settings.layoutName);
+    report->setProperty ("threading", settings.multi ? "multi" : "single");
+    report->setProperty ("precision", settings.precision);
+    report->setProperty ("parameter_overhead", runParameterOverhead());
+    report->setProperty ("results", results);
+
+    // Last: it runs the message loop, which only runs once
+    if (measureEditor)
+        report->setProperty ("editor", runEditor (editorSeconds));
+
+    auto json = juce::JSON::toString (juce::var (report));
+
+    if (args.containsOption ("--output"))
+    {
+        auto file = args.getFileForOption ("--output");
+        return file.replaceWithText (json) ? 0 : 1;
+    }
+
+    std::cout << json << std::endl;
+    return 0;
+}
@@ -0,0 +1,513 @@
+/*
+  ==============================================================================
+
+    CheckMain.cpp
+
+    Golden-output and CPU budget check. Renders fixed test signals (an
+    impulse, a noise burst and a log sweep) through every reverb type at
+    several sample rates and block sizes, null-compares each render against
+    a stored golden file, and times every type against its ns/sample
+    budget. Exits non-zero if anything fails, so a change to processBlock
+    can be shown to be both faster and bit-close before it is merged. With
+    the CONVOLUTION type included it also cancels IR loads part way
+    through, and checks nothing is left with the convolution tail worker.
+
+    Usage:
+      ikreverb-check [--golden-dir=<dir>] [--record] [--tolerance-db=<dB>]
+                     [--no-budgets] [--budget-headroom=<x>] [--types=0,1,...]
+
+    --record writes the goldens and budgets on this machine instead of
+    checking against them. Record on the reference machine, listen to the
+    goldens, and commit them along with the change that altered the sound.
+    Without --record, a missing golden, a missing budget or an unknown type
+    is a failure, never a skip.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "RealtimeSafetyChecker.h"
+#include "ConvolutionReverb.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+
+    // 257 is neither a power of two nor a multiple of the sub-block size
+    const int blockSizes[] = { 32, 257, 1024 };
+    constexpr int goldenBlockSize = 512;
+
+    constexpr double signalSeconds = 0.5;
+    constexpr double renderSeconds = 1.0;
+
+    // Budgets are measured at one configuration, on the noise burst
+    constexpr double budgetSampleRate = 48000.0;
+    constexpr int budgetBlockSize = 512;
+    constexpr double budgetSeconds = 1.0;
+    constexpr int budgetRuns = 5;
+
+    enum class Signal { impulse, noiseBurst, sweep };
+    const Signal signals[] = { Signal::impulse, Signal::noiseBurst, Signal::sweep };
+
+    juce::String getSignalName (Signal signal)
+    {
+        switch (signal)
+        {
+            case Signal::impulse:    return "impulse";
+            case Signal::noiseBurst: return "noise";
+            case Signal::sweep:
+            default:                 return "sweep";
+        }
+    }
+
+    juce::AudioBuffer<float> makeSignal (Signal signal, double sampleRate)
+    {
+        const auto signalLength = (int) (signalSeconds * sampleRate);
+        juce::AudioBuffer<float> buffer (2, (int) (renderSeconds * sampleRate));
+        buffer.clear();
+
+        switch (signal)
+        {
+            case Signal::impulse:
+                buffer.setSample (0, 0, 1.0f);
+                buffer.setSample (1, 0, 1.0f);
+                break;
+
+            case Signal::noiseBurst:
+            {
+                // 50 ms, different on each side
+                juce::Random random (0x1cebu);
+
+                for (int i = 0; i < (int) (0.05 * sampleRate); ++i)
+                    for (int channel = 0; channel < 2; ++channel)
+                        buffer.setSample (channel, i, (random.nextFloat() * 2.0f - 1.0f) * 0.5f);
+                break;
+            }
+
+            case Signal::sweep:
+            {
+                // Exponential sweep from 20 Hz to 20 kHz, or just below Nyquist
+                const auto startHz = 20.0;
+                const auto endHz = juce::jmin (20000.0, sampleRate * 0.45);
+                const auto rate = std::log (endHz / startHz);
+
+                for (int i = 0; i < signalLength; ++i)
+                {
+                    const auto t = i / sampleRate;
+                    const auto phase = juce::MathConstants<double>::twoPi * startHz * signalSeconds / rate
+                                         * (std::exp (t * rate / signalSeconds) - 1.0);
+                    const auto value = (float) (0.5 * std::sin (phase));
+                    buffer.setSample (0, i, value);
+                    buffer.setSample (1, i, value);
+                }
+                break;
+            }
+        }
+
+        return buffer;
+    }
+
+    // A fixed, seeded IR for the CONVOLUTION type, so nothing outside the
+    // tree can change its goldens
+    bool writeTestImpulseResponse (const juce::File& file)
+    {
+        constexpr double irRate = 48000.0;
+        const auto length = (int) (0.6 * irRate);
+        juce::AudioBuffer<float> ir (2, length);
+        juce::Random random (0x51a7u);
+
+        for (int i = 0; i < length; ++i)
+            for (int channel = 0; channel < 2; ++channel)
+                ir.setSample (channel, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp (-6.9f * (float) i / (float) length));
+
+        file.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (file.createOutputStream());
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (stream != nullptr)
+            writer.reset (wav.createWriterFor (stream.get(), irRate, 2, 32, {}, 0));
+
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer (ir, 0, length);
+    }
+
+    void setParameter (IKReverbAudioProcessor& processor, const juce::String& id, float value)
+    {
+        if (auto* param = processor.getAPVTS().getParameter (id))
+            param->setValueNotifyingHost (param->convertTo0to1 (value));
+    }
+
+    // Every stage of the wet path in use, at settings away from the defaults
+    std::unique_ptr<IKReverbAudioProcessor> makeProcessor (int type, const juce::File& impulseResponse)
+    {
+        auto processor = std::make_unique<IKReverbAudioProcessor>();
+
+        setParameter (*processor, "type", (float) type);
+        setParameter (*processor, "size", 0.6f);
+        setParameter (*processor, "damping", 0.4f);
+        setParameter (*processor, "mix", 0.5f);
+        setParameter (*processor, "predelay", 12.0f);
+        setParameter (*processor, "modulation", 0.3f);
+        setParameter (*processor, "lowcut", 60.0f);
+        setParameter (*processor, "highcut", 14000.0f);
+
+        // Budgets are per core, and worker threads would only blur the timing
+        setParameter (*processor, "threading", 0.0f);
+
+        if (type == (int) IKReverbAudioProcessor::ReverbType::Convolution)
+            processor->loadImpulseResponse (impulseResponse);
+
+        // Offline: the convolution tail is computed inline, so renders repeat exactly
+        processor->setNonRealtime (true);
+        return processor;
+    }
+
+    void prepare (IKReverbAudioProcessor& processor, double sampleRate, int blockSize)
+    {
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        while (processor.isLoadingImpulseResponse())
+            juce::Thread::sleep (5);
+
+        // Nothing left over from the last render
+        processor.reset();
+    }
+
+    juce::AudioBuffer<float> render (IKReverbAudioProcessor& processor, const juce::AudioBuffer<float>& input,
+                                     double sampleRate, int blockSize)
+    {
+        prepare (processor, sampleRate, blockSize);
+
+        juce::AudioBuffer<float> output (input);
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < output.getNumSamples(); start += blockSize)
+        {
+            juce::AudioBuffer<float> block (output.getArrayOfWritePointers(), output.getNumChannels(), start,
+                                            juce::jmin (blockSize, output.getNumSamples() - start));
+            processor.processBlock (block, midi);
+        }
+
+        processor.releaseResources();
+        return output;
+    }
+
+    bool writeGolden (const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (file.createOutputStream());
+        juce::FlacAudioFormat flac;
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (stream != nullptr)
+            writer.reset (flac.createWriterFor (stream.get(), sampleRate, (unsigned int) audio.getNumChannels(), 24, {}, 0));
+
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples());
+    }
+
+    bool readGolden (const juce::File& file, juce::AudioBuffer<float>& audio)
+    {
+        juce::FlacAudioFormat flac;
+        auto stream = file.createInputStream();
+
+        if (stream == nullptr)
+            return false;
+
+        std::unique_ptr<juce::AudioFormatReader> reader (flac.createReaderFor (stream.release(), true));
+
+        if (reader == nullptr)
+            return false;
+
+        audio.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
+        return reader->read (&audio, 0, audio.getNumSamples(), 0, true, true);
+    }
+
+    // Largest difference from the golden, in dB below the golden's peak
+    double getResidualDecibels (const juce::AudioBuffer<float>& audio, const juce::AudioBuffer<float>& golden)
+    {
+        if (audio.getNumChannels() != golden.getNumChannels() || audio.getNumSamples() != golden.getNumSamples())
+            return std::numeric_limits<double>::infinity();
+
+        float maxDifference = 0.0f;
+
+        for (int channel = 0; channel < audio.getNumChannels(); ++channel)
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                maxDifference = juce::jmax (maxDifference, std::abs (audio.getSample (channel, i) - golden.getSample (channel, i)));
+
+        const auto peak = juce::jmax (1.0e-9f, golden.getMagnitude (0, golden.getNumSamples()));
+        return juce::Decibels::gainToDecibels ((double) maxDifference / peak, -300.0);
+    }
+
+    // Fastest of a few runs, which is the least disturbed by the rest of the machine
+    double measureNanosPerSample (IKReverbAudioProcessor& processor)
+    {
+        prepare (processor, budgetSampleRate, budgetBlockSize);
+
+        const auto source = makeSignal (Signal::noiseBurst, budgetSampleRate);
+        juce::AudioBuffer<float> block (2, budgetBlockSize);
+        juce::MidiBuffer midi;
+        const auto numBlocks = (int) (budgetSeconds * budgetSampleRate / budgetBlockSize);
+        auto best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < budgetRuns; ++run)
+        {
+            double nanos = 0.0;
+
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                const auto sourceStart = (i * budgetBlockSize) % (source.getNumSamples() - budgetBlockSize);
+
+                for (int channel = 0; channel < 2; ++channel)
+                    block.copyFrom (channel, 0, source, channel, sourceStart, budgetBlockSize);
+
+                const auto start = std::chrono::steady_clock::now();
+                processor.processBlock (block, midi);
+                const auto end = std::chrono::steady_clock::now();
+                nanos += (double) std::chrono::duration_cast<std::chrono::nanoseconds> (end - start).count();
+            }
+
+            best = juce::jmin (best, nanos / ((double) numBlocks * budgetBlockSize));
+        }
+
+        processor.releaseResources();
+        return best;
+    }
+
+    // Cancels IR loads at different points of the build, by destroying the
+    // reverb while its loader is busy. Every convolver a load gave the
+    // shared tail worker must be gone again afterwards, or the worker is
+    // left holding freed pointers. Returns an empty string on success.
+    juce::String checkCancelledLoads()
+    {
+        juce::SharedResourcePointer<ConvolutionTailWorker> tailWorker;
+        const auto registeredBefore = tailWorker->getNumConvolvers();
+
+        constexpr double irRate = 48000.0;
+        constexpr int numChannels = 8;
+        juce::AudioBuffer<float> ir (2, (int) (10.0 * irRate));
+        juce::Random random (0xca9cu);
+
+        for (int channel = 0; channel < ir.getNumChannels(); ++channel)
+            for (int i = 0; i < ir.getNumSamples(); ++i)
+                ir.setSample (channel, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp (-3.0f * (float) i / (float) ir.getNumSamples()));
+
+        // A load that completes registers one convolver per channel
+        {
+            ConvolutionReverb reverb;
+            reverb.prepare ({ irRate, 512, (juce::uint32) numChannels });
+            reverb.loadImpulseResponse (ir, irRate, "cancel test");
+
+            while (reverb.isBuilding())
+                juce::Thread::sleep (5);
+
+            const auto registered = tailWorker->getNumConvolvers() - registeredBefore;
+
+            if (registered != numChannels)
+                return juce::String (registered) + " convolvers registered by a finished load, expected " + juce::String (numChannels);
+        }
+
+        if (tailWorker->getNumConvolvers() != registeredBefore)
+            return "a finished engine was left registered after its reverb was destroyed";
+
+        // Cancelled anywhere from before the build starts to after it is done
+        for (int attempt = 0; attempt < 24; ++attempt)
+        {
+            {
+                ConvolutionReverb reverb;
+                reverb.prepare ({ irRate, 512, (juce::uint32) numChannels });
+                reverb.loadImpulseResponse (ir, irRate, "cancel test");
+                juce::Thread::sleep (attempt * 4);
+            }
+
+            const auto leaked = tailWorker->getNumConvolvers() - registeredBefore;
+
+            if (leaked != 0)
+                return juce::String (leaked) + " convolvers left registered after cancelling at " + juce::String (attempt * 4) + " ms";
+        }
+
+        return {};
+    }
+
+    template <typename ValueType>
+    juce::Array<ValueType> parseList (const juce::String& text)
+    {
+        juce::Array<ValueType> values;
+
+        for (auto& token : juce::StringArray::fromTokens (text, ",", {}))
+            if (token.trim().isNotEmpty())
+                values.add ((ValueType) token.trim().getDoubleValue());
+
+        return values;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    auto goldenDir = args.containsOption ("--golden-dir")
+                         ? args.getFileForOption ("--golden-dir")
+                         : juce::File::getCurrentWorkingDirectory().getChildFile ("tools/check/golden");
+    const auto record = args.containsOption ("--record");
+    const auto checkBudgets = ! args.containsOption ("--no-budgets");
+    const auto toleranceDb = args.containsOption ("--tolerance-db") ? args.getValueForOption ("--tolerance-db").getDoubleValue() : -80.0;
+    const auto headroom = args.containsOption ("--budget-headroom") ? args.getValueForOption ("--budget-headroom").getDoubleValue() : 1.5;
+
+    juce::StringArray typeNames;
+
+    {
+        IKReverbAudioProcessor probe;
+
+        if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (probe.getAPVTS().getParameter ("type")))
+            typeNames = choice->choices;
+    }
+
+    juce::Array<int> types;
+
+    for (int i = 0; i < typeNames.size(); ++i)
+        types.add (i);
+
+    if (args.containsOption ("--types"))
+        types = parseList<int> (args.getValueForOption ("--types"));
+
+    if (record && ! goldenDir.createDirectory())
+    {
+        std::cerr << "Can't create " << goldenDir.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    if (! record && ! goldenDir.isDirectory())
+    {
+        std::cerr << "No goldens at " << goldenDir.getFullPathName() << "; run with --record first" << std::endl;
+        return 1;
+    }
+
+    auto impulseResponse = juce::File::createTempFile (".wav");
+
+    if (! writeTestImpulseResponse (impulseResponse))
+    {
+        std::cerr << "Can't write the test IR" << std::endl;
+        return 1;
+    }
+
+    RealtimeSafetyChecker::setMode (RealtimeSafetyChecker::Mode::countViolations);
+    RealtimeSafetyChecker::resetViolations();
+
+    const auto budgetFile = goldenDir.getChildFile ("budgets.json");
+    auto budgets = juce::JSON::parse (budgetFile);
+
+    // Recording some of the types keeps the budgets of the others
+    if (record && budgets.getDynamicObject() == nullptr)
+        budgets = juce::var (new juce::DynamicObject());
+
+    int numChecks = 0, numFailures = 0;
+
+    auto report = [&] (bool passed, const juce::String& what, const juce::String& detail)
+    {
+        ++numChecks;
+        numFailures += passed ? 0 : 1;
+        std::cerr << (passed ? "PASS " : "FAIL ") << what << ": " << detail << std::endl;
+    };
+
+    for (auto type : types)
+    {
+        if (! juce::isPositiveAndBelow (type, typeNames.size()))
+        {
+            report (false, "type " + juce::String (type), "no such type");
+            continue;
+        }
+
+        const auto typeName = typeNames[type];
+        auto processor = makeProcessor (type, impulseResponse);
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto signal : signals)
+            {
+                const auto input = makeSignal (signal, sampleRate);
+                const auto name = typeName.toLowerCase() + "_" + getSignalName (signal) + "_" + juce::String ((int) sampleRate);
+                const auto file = goldenDir.getChildFile (name + ".flac");
+
+                if (record)
+                {
+                    const auto ok = writeGolden (file, render (*processor, input, sampleRate, goldenBlockSize), sampleRate);
+                    report (ok, name, ok ? "recorded" : "can't write " + file.getFullPathName());
+                    continue;
+                }
+
+                juce::AudioBuffer<float> golden;
+
+                if (! readGolden (file, golden))
+                {
+                    report (false, name, "no golden at " + file.getFullPathName());
+                    continue;
+                }
+
+                for (auto blockSize : blockSizes)
+                {
+                    const auto residual = getResidualDecibels (render (*processor, input, sampleRate, blockSize), golden);
+                    report (residual <= toleranceDb, name + ", block " + juce::String (blockSize),
+                            juce::String (residual, 1) + " dB residual (limit " + juce::String (toleranceDb, 1) + " dB)");
+                }
+            }
+        }
+
+        if (! checkBudgets)
+            continue;
+
+        const auto nanos = measureNanosPerSample (*processor);
+
+        if (record)
+        {
+            budgets.getDynamicObject()->setProperty (typeName, nanos * headroom);
+            report (true, typeName + " budget", juce::String (nanos, 2) + " ns/sample, budget set to "
+                                                  + juce::String (nanos * headroom, 2));
+        }
+        else if (budgets.hasProperty (typeName))
+        {
+            const auto budget = (double) budgets[juce::Identifier (typeName)];
+            report (nanos <= budget, typeName + " budget",
+                    juce::String (nanos, 2) + " ns/sample (budget " + juce::String (budget, 2) + ")");
+        }
+        else
+        {
+            report (false, typeName + " budget", "no budget in " + budgetFile.getFullPathName());
+        }
+    }
+
+    impulseResponse.deleteFile();
+
+    if (types.contains ((int) IKReverbAudioProcessor::ReverbType::Convolution))
+    {
+        const auto failure = checkCancelledLoads();
+        report (failure.isEmpty(), "cancelled IR loads", failure.isEmpty() ? "no convolvers left with the tail worker" : failure);
+    }
+
+    if (record && checkBudgets && ! budgetFile.replaceWithText (juce::JSON::toString (budgets)))
+        report (false, "budgets", "can't write " + budgetFile.getFullPathName());
+
+    // A run that compared nothing must not pass
+    if (numChecks == 0)
+        report (false, "goldens", "nothing was checked");
+
+    const auto violations = RealtimeSafetyChecker::getNumViolations();
+    report (violations == 0, "realtime safety", juce::String (violations) + " violations in processBlock");
+
+    std::cerr << numChecks - numFailures << " of " << numChecks << " checks passed" << std::endl;
+    return numFailures == 0 ? 0 : 1;
+}
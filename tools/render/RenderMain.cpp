@@ -0,0 +1,409 @@
+/*
+  ==============================================================================
+
+    RenderMain.cpp
+
+    Offline batch renderer. Streams audio files through
+    IKReverbAudioProcessor in large blocks and writes the results, tail
+    included, without a DAW. Files are shared out over worker threads, each
+    with its own processor, and every file's throughput is reported as a
+    multiple of real time, along with the total per core.
+
+    Usage:
+      ikreverb-render [--preset=<file>] [--set=<id>=<value>,...] [--jobs=<n>]
+                      [--output-dir=<dir>] [--suffix=<text>] [--format=wav|flac|aiff]
+                      [--block-size=<n>] [--no-tail] [--max-tail=<s>] <input files...>
+
+    --preset takes the plugin state as XML or as the binary blob a host
+    saves. --set overrides single parameters in their own units; choices
+    also take their names, e.g. --set=type=HALL,size=0.8,mix=1.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "RealtimeSafetyChecker.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    struct RenderSettings
+    {
+        juce::File preset;
+        juce::StringPairArray overrides;
+        juce::File outputDirectory;
+        juce::String suffix = "_ikreverb";
+        juce::String format;            // Output extension; empty = same as the input
+        int jobs = 0;
+        int blockSize = 8192;
+        bool renderTail = true;
+        double maxTailSeconds = 60.0;
+    };
+
+    struct FileResult
+    {
+        juce::File input, output;
+        juce::String error;
+        double audioSeconds = 0.0;
+        double processSeconds = 0.0;    // processBlock only
+        double totalSeconds = 0.0;      // Including decoding and encoding
+    };
+
+    bool layoutForChannels (int numChannels, juce::AudioChannelSet& layout)
+    {
+        switch (numChannels)
+        {
+            case 1:  layout = juce::AudioChannelSet::mono(); return true;
+            case 2:  layout = juce::AudioChannelSet::stereo(); return true;
+            case 6:  layout = juce::AudioChannelSet::create5point1(); return true;
+            case 8:  layout = juce::AudioChannelSet::create7point1(); return true;
+            case 12: layout = juce::AudioChannelSet::create7point1point4(); return true;
+            default: return false;
+        }
+    }
+
+    bool setParameter (IKReverbAudioProcessor& processor, const juce::String& id, const juce::String& text)
+    {
+        auto* param = processor.getAPVTS().getParameter (id);
+
+        if (param == nullptr)
+            return false;
+
+        // Choices by name or by index
+        if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (param))
+        {
+            auto index = choice->choices.indexOf (text.trim(), true);
+
+            if (index < 0 && text.containsOnly ("0123456789"))
+                index = text.getIntValue();
+
+            if (! juce::isPositiveAndBelow (index, choice->choices.size()))
+                return false;
+
+            param->setValueNotifyingHost (param->convertTo0to1 ((float) index));
+            return true;
+        }
+
+        param->setValueNotifyingHost (param->convertTo0to1 (text.getFloatValue()));
+        return true;
+    }
+
+    bool loadPreset (IKReverbAudioProcessor& processor, const juce::File& file)
+    {
+        juce::MemoryBlock state;
+
+        if (auto xml = juce::XmlDocument::parse (file))
+        {
+            if (! xml->hasTagName (processor.getAPVTS().state.getType()))
+                return false;
+
+            juce::AudioProcessor::copyXmlToBinary (*xml, state);
+        }
+        else if (! file.loadFileAsData (state))
+        {
+            return false;
+        }
+
+        processor.setStateInformation (state.getData(), (int) state.getSize());
+        return true;
+    }
+
+    // Called on the main thread, before the workers start, so the
+    // parameter state is never touched from two threads
+    juce::String configure (IKReverbAudioProcessor& processor, const RenderSettings& settings)
+    {
+        if (settings.preset != juce::File() && ! loadPreset (processor, settings.preset))
+            return "Can't read preset " + settings.preset.getFullPathName();
+
+        for (auto& id : settings.overrides.getAllKeys())
+            if (! setParameter (processor, id, settings.overrides[id]))
+                return "Bad parameter: " + id + "=" + settings.overrides[id];
+
+        // Files are already rendered in parallel; the pool would only oversubscribe
+        setParameter (processor, "threading", "SINGLE");
+        processor.setNonRealtime (true);
+        return {};
+    }
+
+    int chooseBitDepth (juce::AudioFormat& format, int sourceBits)
+    {
+        auto depths = format.getPossibleBitDepths();
+
+        for (auto bits : depths)
+            if (bits >= sourceBits)
+                return bits;
+
+        return depths.isEmpty() ? 16 : depths.getLast();
+    }
+
+    void renderFile (IKReverbAudioProcessor& processor, juce::AudioFormatManager& formats,
+                     const RenderSettings& settings, FileResult& result)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (result.input));
+
+        if (reader == nullptr || reader->sampleRate <= 0.0)
+        {
+            result.error = "can't read the file";
+            return;
+        }
+
+        const auto numChannels = (int) reader->numChannels;
+        const auto sampleRate = reader->sampleRate;
+        juce::AudioChannelSet layout;
+        juce::AudioProcessor::BusesLayout buses;
+
+        if (layoutForChannels (numChannels, layout))
+        {
+            buses.inputBuses.add (layout);
+            buses.outputBuses.add (layout);
+        }
+
+        if (buses.outputBuses.isEmpty() || ! processor.setBusesLayout (buses))
+        {
+            result.error = "unsupported channel count " + juce::String (numChannels);
+            return;
+        }
+
+        // Output next to the input unless told otherwise
+        auto extension = settings.format.isNotEmpty() ? "." + settings.format : result.input.getFileExtension();
+        auto* format = formats.findFormatForFileExtension (extension);
+        auto directory = settings.outputDirectory != juce::File() ? settings.outputDirectory : result.input.getParentDirectory();
+        result.output = directory.getChildFile (result.input.getFileNameWithoutExtension() + settings.suffix + extension);
+
+        if (format == nullptr)
+        {
+            result.error = "unknown output format " + extension;
+            return;
+        }
+
+        if (result.output == result.input)
+        {
+            result.error = "output would overwrite the input";
+            return;
+        }
+
+        result.output.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (result.output.createOutputStream());
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+
+        if (stream != nullptr)
+            writer.reset (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels,
+                                                   chooseBitDepth (*format, (int) reader->bitsPerSample),
+                                                   reader->metadataValues, 0));
+
+        if (writer == nullptr)
+        {
+            result.error = "can't write " + juce::String (numChannels) + " channels to " + result.output.getFullPathName();
+            return;
+        }
+
+        stream.release();   // Owned by the writer now
+
+        processor.setRateAndBufferSizeDetails (sampleRate, settings.blockSize);
+        processor.prepareToPlay (sampleRate, settings.blockSize);
+
+        // Picks up the convolution IR, rebuilt for this sample rate
+        while (processor.isLoadingImpulseResponse())
+            juce::Thread::sleep (5);
+
+        // The processor's latency is cut from the start of the output, and
+        // the tail is run out past the end of the input
+        const auto latency = (juce::int64) processor.getLatencySamples();
+        const auto inputLength = reader->lengthInSamples;
+        const auto tailLength = settings.renderTail
+                                    ? (juce::int64) std::ceil (juce::jmin (settings.maxTailSeconds, processor.getTailLengthSeconds()) * sampleRate)
+                                    : 0;
+        const auto totalLength = latency + inputLength + tailLength;
+
+        juce::AudioBuffer<float> buffer (numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+        double processNanos = 0.0;
+
+        for (juce::int64 position = 0; position < totalLength; position += settings.blockSize)
+        {
+            const auto numSamples = (int) juce::jmin ((juce::int64) settings.blockSize, totalLength - position);
+            buffer.setSize (numChannels, numSamples, false, false, true);
+            buffer.clear();
+
+            if (position < inputLength)
+                reader->read (&buffer, 0, (int) juce::jmin ((juce::int64) numSamples, inputLength - position), position, true, true);
+
+            const auto start = std::chrono::steady_clock::now();
+            processor.processBlock (buffer, midi);
+            const auto end = std::chrono::steady_clock::now();
+            processNanos += (double) std::chrono::duration_cast<std::chrono::nanoseconds> (end - start).count();
+
+            const auto skip = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numSamples, latency - position);
+
+            if (! writer->writeFromAudioSampleBuffer (buffer, skip, numSamples - skip))
+            {
+                result.error = "write failed";
+                return;
+            }
+        }
+
+        processor.releaseResources();
+        writer.reset();
+
+        result.audioSeconds = (double) (inputLength + tailLength) / sampleRate;
+        result.processSeconds = processNanos * 1.0e-9;
+        result.totalSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Usage: ikreverb-render [--preset=<file>] [--set=<id>=<value>,...] [--jobs=<n>]\n"
+                     "                       [--output-dir=<dir>] [--suffix=<text>] [--format=wav|flac|aiff]\n"
+                     "                       [--block-size=<n>] [--no-tail] [--max-tail=<s>] <input files...>"
+                  << std::endl;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    RenderSettings settings;
+    juce::Array<juce::File> inputs;
+
+    for (auto& argument : args.arguments)
+        if (! argument.isOption())
+            inputs.add (argument.resolveAsFile());
+
+    if (inputs.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (args.containsOption ("--preset"))
+        settings.preset = args.getFileForOption ("--preset");
+
+    if (args.containsOption ("--set"))
+    {
+        for (auto& pair : juce::StringArray::fromTokens (args.getValueForOption ("--set"), ",", {}))
+        {
+            if (! pair.contains ("="))
+            {
+                std::cerr << "Expected <id>=<value>, got " << pair << std::endl;
+                return 1;
+            }
+
+            settings.overrides.set (pair.upToFirstOccurrenceOf ("=", false, false).trim(),
+                                    pair.fromFirstOccurrenceOf ("=", false, false).trim());
+        }
+    }
+
+    if (args.containsOption ("--output-dir"))
+    {
+        settings.outputDirectory = args.getFileForOption ("--output-dir");
+
+        if (! settings.outputDirectory.createDirectory())
+        {
+            std::cerr << "Can't create " << settings.outputDirectory.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    if (args.containsOption ("--suffix"))
+        settings.suffix = args.getValueForOption ("--suffix");
+
+    if (args.containsOption ("--format"))
+        settings.format = args.getValueForOption ("--format").trimCharactersAtStart (".").toLowerCase();
+
+    if (args.containsOption ("--block-size"))
+        settings.blockSize = juce::jlimit (16, 65536, args.getValueForOption ("--block-size").getIntValue());
+
+    if (args.containsOption ("--max-tail"))
+        settings.maxTailSeconds = juce::jmax (0.0, args.getValueForOption ("--max-tail").getDoubleValue());
+
+    settings.renderTail = ! args.containsOption ("--no-tail");
+    settings.jobs = args.containsOption ("--jobs") ? args.getValueForOption ("--jobs").getIntValue()
+                                                   : juce::SystemStats::getNumCpus();
+    settings.jobs = juce::jlimit (1, inputs.size(), settings.jobs);
+
+    // Allocations in processBlock don't matter offline; count them rather
+    // than abort when the tool is built with the checks on
+    RealtimeSafetyChecker::setMode (RealtimeSafetyChecker::Mode::countViolations);
+
+    // One processor per worker, all set up here on the main thread
+    std::vector<std::unique_ptr<IKReverbAudioProcessor>> processors;
+
+    for (int i = 0; i < settings.jobs; ++i)
+    {
+        processors.push_back (std::make_unique<IKReverbAudioProcessor>());
+        auto error = configure (*processors.back(), settings);
+
+        if (error.isNotEmpty())
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<FileResult> results ((size_t) inputs.size());
+
+    for (int i = 0; i < inputs.size(); ++i)
+        results[(size_t) i].input = inputs[i];
+
+    // Workers take the next file until none are left
+    std::atomic<int> nextFile { 0 };
+    std::vector<std::thread> workers;
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (auto& processor : processors)
+    {
+        workers.emplace_back ([&, processor = processor.get()]
+        {
+            juce::AudioFormatManager formats;
+            formats.registerBasicFormats();
+
+            for (int index; (index = nextFile.fetch_add (1)) < (int) results.size();)
+                renderFile (*processor, formats, settings, results[(size_t) index]);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    const auto wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - startTime).count();
+
+    // Report
+    double totalAudioSeconds = 0.0, totalProcessSeconds = 0.0;
+    int numFailed = 0;
+
+    for (auto& result : results)
+    {
+        if (result.error.isNotEmpty())
+        {
+            std::cerr << result.input.getFullPathName() << ": " << result.error << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        totalAudioSeconds += result.audioSeconds;
+        totalProcessSeconds += result.processSeconds;
+
+        std::cerr << result.output.getFileName() << ": " << result.audioSeconds << " s of audio, "
+                  << result.audioSeconds / juce::jmax (1.0e-9, result.processSeconds) << "x realtime in processBlock, "
+                  << result.audioSeconds / juce::jmax (1.0e-9, result.totalSeconds) << "x with file I/O" << std::endl;
+    }
+
+    const auto overall = totalAudioSeconds / juce::jmax (1.0e-9, wallSeconds);
+
+    std::cerr << results.size() - (size_t) numFailed << " of " << results.size() << " files, "
+              << totalAudioSeconds << " s of audio in " << wallSeconds << " s on " << settings.jobs << " threads: "
+              << overall << "x realtime, " << overall / settings.jobs << "x per core ("
+              << totalAudioSeconds / juce::jmax (1.0e-9, totalProcessSeconds) << "x in processBlock alone)" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}